@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "nvh/nvprint.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// Scaling benchmark: runs a list of configurations one after the other, and for each of them
+// measures how many pixels per second all producers together are writing.
+// - The application asks for the configuration to use with current() before rendering a frame
+// - After the frame, it reports the number of pixels written with frame()
+// The frames are timed on the CPU, so the swap mode must not cap them (no vsync, no limiter).
+//
+class ScalingBenchmark
+{
+public:
+  struct Step
+  {
+    uint32_t producers{1};
+    uint32_t queues{1};
+  };
+
+  struct Result
+  {
+    Step   step;
+    double gpixelsPerSecond{0.0};
+    double msPerFrame{0.0};
+  };
+
+  // Producer counts 1, 2, 4, ... up to maxProducers (always included)
+  static std::vector<Step> producerSweep(uint32_t maxProducers)
+  {
+    std::vector<Step> steps;
+    for(uint32_t n = 1; n < maxProducers; n *= 2)
+      steps.push_back({.producers = n});
+    steps.push_back({.producers = maxProducers});
+    return steps;
+  }
+
+  // Every producer count of producerSweep() with 1, 2, 4, ... up to maxQueues queues
+  static std::vector<Step> queueSweep(uint32_t maxProducers, uint32_t maxQueues)
+  {
+    std::vector<Step> steps;
+    for(const Step& p : producerSweep(maxProducers))
+    {
+      for(uint32_t q = 1; q < maxQueues; q *= 2)
+        steps.push_back({.producers = p.producers, .queues = q});
+      steps.push_back({.producers = p.producers, .queues = maxQueues});
+    }
+    return steps;
+  }
+
+  void start(std::vector<Step> steps)
+  {
+    m_steps = std::move(steps);
+    m_results.clear();
+    m_current = 0;
+    beginStep();
+  }
+
+  bool        isRunning() const { return m_current < m_steps.size(); }
+  const Step& current() const { return m_steps[m_current]; }
+  float       progress() const { return m_steps.empty() ? 1.f : float(m_current) / float(m_steps.size()); }
+
+  const std::vector<Result>& results() const { return m_results; }
+
+  // Call once per presented frame with the number of pixels written by all producers
+  void frame(double pixels)
+  {
+    if(!isRunning())
+      return;
+
+    auto now = std::chrono::high_resolution_clock::now();
+    // Let the new configuration settle (resource creation, clocks) before measuring
+    if(m_warmupFrames > 0)
+    {
+      if(--m_warmupFrames == 0)
+        m_tStart = now;
+      return;
+    }
+
+    m_frames++;
+    m_pixels += pixels;
+    double seconds = std::chrono::duration<double>(now - m_tStart).count();
+    if(seconds < kMeasureSeconds)
+      return;
+
+    m_results.push_back({.step             = current(),
+                         .gpixelsPerSecond = m_pixels / seconds * 1e-9,
+                         .msPerFrame       = seconds * 1000.0 / double(m_frames)});
+    m_current++;
+    if(isRunning())
+      beginStep();
+    else
+      report();
+  }
+
+  void report() const
+  {
+    LOGI("Scaling benchmark\n");
+    LOGI(" producers | queues | ms/frame | Gpixels/s | per producer\n");
+    for(const auto& r : m_results)
+    {
+      LOGI(" %9u | %6u | %8.3f | %9.3f | %12.3f\n", r.step.producers, r.step.queues, r.msPerFrame,
+           r.gpixelsPerSecond, r.gpixelsPerSecond / double(r.step.producers));
+    }
+  }
+
+private:
+  static constexpr int    kWarmupFrames   = 30;
+  static constexpr double kMeasureSeconds = 2.0;
+
+  void beginStep()
+  {
+    m_warmupFrames = kWarmupFrames;
+    m_frames       = 0;
+    m_pixels       = 0.0;
+  }
+
+  std::vector<Step>   m_steps;
+  std::vector<Result> m_results;
+  size_t              m_current{0};
+
+  int                                            m_warmupFrames{0};
+  uint64_t                                       m_frames{0};
+  double                                         m_pixels{0.0};
+  std::chrono::high_resolution_clock::time_point m_tStart;
+};
+
+//--------------------------------------------------------------------------------------------------
+// GPU benchmark of a pass: runs each variant of the pass (e.g. its implementations) for each value
+// of a parameter (e.g. a radius or a size), and averages the GPU time the pass reports over some
+// frames. The results are a table of the parameter by variant.
+// - The application configures the pass as current() says before rendering a frame
+// - After the frame, it reports the GPU time of the pass with frame()
+//
+class GpuPassBenchmark
+{
+public:
+  struct Step
+  {
+    uint32_t variant{0};  // Index in the names given to start()
+    uint32_t param{0};
+  };
+
+  struct Result
+  {
+    Step   step;
+    double gpuMs{0.0};
+  };
+
+  // Steps for which `isSupported` is false are skipped, their time is negative
+  void start(std::vector<std::string> variants, const std::vector<uint32_t>& params, std::function<bool(const Step&)> isSupported = {})
+  {
+    m_variants    = std::move(variants);
+    m_params      = params;
+    m_isSupported = std::move(isSupported);
+    m_steps.clear();
+    for(uint32_t param : params)
+      for(uint32_t v = 0; v < uint32_t(m_variants.size()); v++)
+        m_steps.push_back({.variant = v, .param = param});
+    m_results.clear();
+    m_current = 0;
+    nextStep();
+  }
+
+  bool        isRunning() const { return m_current < m_steps.size(); }
+  const Step& current() const { return m_steps[m_current]; }
+  float       progress() const { return m_steps.empty() ? 1.f : float(m_current) / float(m_steps.size()); }
+
+  const std::vector<Result>&      results() const { return m_results; }
+  const std::vector<std::string>& variants() const { return m_variants; }
+
+  // Call once per frame with the GPU time of the pass, negative when it was not measured. The time of
+  // a frame is only known a frame later, the warm-up frames skip the previous configuration.
+  void frame(double gpuMs)
+  {
+    if(!isRunning())
+      return;
+    if(m_warmupFrames > 0)
+    {
+      m_warmupFrames--;
+      return;
+    }
+    if(gpuMs >= 0.0)
+    {
+      m_totalMs += gpuMs;
+      m_frames++;
+    }
+    if(m_frames < kMeasureFrames)
+      return;
+
+    m_results.push_back({.step = current(), .gpuMs = m_totalMs / double(m_frames)});
+    m_current++;
+    nextStep();
+  }
+
+  // Smallest parameter from which `variant` is faster than `other` for all the following measured
+  // parameters, 0 if there is none
+  uint32_t crossover(uint32_t variant, uint32_t other) const
+  {
+    uint32_t param = 0;
+    for(size_t i = 0; i + m_variants.size() <= m_results.size(); i += m_variants.size())
+    {
+      const double a = m_results[i + variant].gpuMs;
+      const double b = m_results[i + other].gpuMs;
+      if(a < 0.0 || b < 0.0)
+        continue;
+      if(a >= b)
+        param = 0;
+      else if(param == 0)
+        param = m_results[i].step.param;
+    }
+    return param;
+  }
+
+  // `title` and the name of the parameter head the table
+  void report(const char* title, const char* paramName) const
+  {
+    LOGI("%s\n", title);
+    std::string header = " " + std::string(paramName);
+    for(const std::string& variant : m_variants)
+      header += " | " + variant;
+    LOGI("%s (ms)\n", header.c_str());
+    for(size_t i = 0; i + m_variants.size() <= m_results.size(); i += m_variants.size())
+    {
+      std::string line = " " + std::to_string(m_results[i].step.param);
+      line.resize(std::max(line.size(), strlen(paramName) + 1), ' ');
+      for(size_t v = 0; v < m_variants.size(); v++)
+      {
+        char cell[32];
+        if(m_results[i + v].gpuMs < 0.0)
+          snprintf(cell, sizeof(cell), " | %*s", int(m_variants[v].size()), "-");
+        else
+          snprintf(cell, sizeof(cell), " | %*.3f", int(m_variants[v].size()), m_results[i + v].gpuMs);
+        line += cell;
+      }
+      LOGI("%s\n", line.c_str());
+    }
+  }
+
+private:
+  static constexpr int      kWarmupFrames  = 10;
+  static constexpr uint64_t kMeasureFrames = 60;
+
+  // Skips the unsupported steps, and starts the next supported one
+  void nextStep()
+  {
+    while(isRunning() && m_isSupported && !m_isSupported(current()))
+    {
+      m_results.push_back({.step = current(), .gpuMs = -1.0});
+      m_current++;
+    }
+    m_warmupFrames = kWarmupFrames;
+    m_frames       = 0;
+    m_totalMs      = 0.0;
+  }
+
+  std::vector<std::string>         m_variants;
+  std::vector<uint32_t>            m_params;
+  std::function<bool(const Step&)> m_isSupported;
+  std::vector<Step>                m_steps;
+  std::vector<Result>              m_results;
+  size_t                           m_current{0};
+
+  int      m_warmupFrames{0};
+  uint64_t m_frames{0};
+  double   m_totalMs{0.0};
+};
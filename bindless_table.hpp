@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "nvvk/error_vk.hpp"
+
+namespace nvvk {
+
+//--------------------------------------------------------------------------------------------------
+// Descriptor table shared by all producers, with descriptor indexing:
+// - binding 0: array of storage images, written by the kernels (image2D without format)
+// - binding 1: array of sampled images, for kernels reading other images
+// The arrays are partially bound and update-after-bind: images are added and removed while other
+// command buffers using the table are pending, and a kernel selects its image with a push constant.
+// There is one set and one pipeline layout, bound once per command buffer, whatever the number of images.
+//
+class BindlessImageTable
+{
+public:
+  static constexpr uint32_t kInvalidSlot = ~0u;
+
+  // Descriptor indexing features needed, see init()
+  static bool isSupported(VkPhysicalDevice physicalDevice)
+  {
+    VkPhysicalDeviceVulkan12Features features12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2 features{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &features12};
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    return features12.runtimeDescriptorArray && features12.descriptorBindingPartiallyBound
+           && features12.descriptorBindingStorageImageUpdateAfterBind && features12.descriptorBindingSampledImageUpdateAfterBind
+           && features12.descriptorBindingUpdateUnusedWhilePending && features.features.shaderStorageImageWriteWithoutFormat;
+  }
+
+  // Up to `capacity` images, fewer if the device limits are lower.
+  // `pushConstantSize` is the size of the compute push constants of the pipeline layout.
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t capacity, uint32_t pushConstantSize)
+  {
+    m_device = device;
+
+    VkPhysicalDeviceVulkan12Properties properties12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &properties12};
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    m_capacity = std::min({capacity, properties12.maxPerStageDescriptorUpdateAfterBindStorageImages,
+                           properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                           properties12.maxDescriptorSetUpdateAfterBindStorageImages,
+                           properties12.maxDescriptorSetUpdateAfterBindSampledImages});
+
+    const VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+                                                  | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    const VkDescriptorBindingFlags              flags[] = {bindingFlags, bindingFlags};
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+                                                          .bindingCount  = 2,
+                                                          .pBindingFlags = flags};
+    const VkDescriptorSetLayoutBinding bindings[] = {
+        {.binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = m_capacity, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+        {.binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = m_capacity, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+    };
+    VkDescriptorSetLayoutCreateInfo layoutInfo{.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                                               .pNext        = &flagsInfo,
+                                               .flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+                                               .bindingCount = 2,
+                                               .pBindings    = bindings};
+    NVVK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_setLayout));
+
+    const VkDescriptorPoolSize poolSizes[] = {
+        {.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = m_capacity},
+        {.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = m_capacity},
+    };
+    VkDescriptorPoolCreateInfo poolInfo{.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                                        .flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+                                        .maxSets       = 1,
+                                        .poolSizeCount = 2,
+                                        .pPoolSizes    = poolSizes};
+    NVVK_CHECK(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_pool));
+
+    VkDescriptorSetAllocateInfo allocInfo{.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                                          .descriptorPool     = m_pool,
+                                          .descriptorSetCount = 1,
+                                          .pSetLayouts        = &m_setLayout};
+    NVVK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, &m_set));
+
+    VkPushConstantRange        pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = pushConstantSize};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                                  .setLayoutCount         = 1,
+                                                  .pSetLayouts            = &m_setLayout,
+                                                  .pushConstantRangeCount = 1,
+                                                  .pPushConstantRanges    = &pushConstants};
+    NVVK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout));
+
+    m_freeSlots.clear();
+    for(uint32_t slot = m_capacity; slot > 0; slot--)
+      m_freeSlots.push_back(slot - 1);
+  }
+
+  void deinit()
+  {
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+    *this = {};
+  }
+
+  bool isValid() const { return m_set != VK_NULL_HANDLE; }
+
+  // Adds an image in GENERAL layout to both arrays, returns its slot, or kInvalidSlot when the table is full
+  uint32_t add(VkImageView view)
+  {
+    if(m_freeSlots.empty())
+      return kInvalidSlot;
+    const uint32_t slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+
+    VkDescriptorImageInfo imageInfo{.imageView = view, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    VkWriteDescriptorSet  storageWrite{.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                       .dstSet          = m_set,
+                                       .dstBinding      = 0,
+                                       .dstArrayElement = slot,
+                                       .descriptorCount = 1,
+                                       .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                       .pImageInfo      = &imageInfo};
+    VkWriteDescriptorSet  sampledWrite = storageWrite;
+    sampledWrite.dstBinding            = 1;
+    sampledWrite.descriptorType        = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+
+    const VkWriteDescriptorSet writes[] = {storageWrite, sampledWrite};
+    vkUpdateDescriptorSets(m_device, 2, writes, 0, nullptr);
+    return slot;
+  }
+
+  // The slot must not be used by pending command buffers anymore. Being partially bound, the stale
+  // descriptor can stay until the slot is reused.
+  void remove(uint32_t slot)
+  {
+    if(slot != kInvalidSlot)
+      m_freeSlots.push_back(slot);
+  }
+
+  void bind(VkCommandBuffer cmd) const
+  {
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_set, 0, nullptr);
+  }
+
+  VkDescriptorSetLayout setLayout() const { return m_setLayout; }
+  VkPipelineLayout      pipelineLayout() const { return m_pipelineLayout; }
+  uint32_t              capacity() const { return m_capacity; }
+  uint32_t              size() const { return m_capacity - uint32_t(m_freeSlots.size()); }
+
+private:
+  VkDevice              m_device{};
+  VkDescriptorSetLayout m_setLayout{};
+  VkDescriptorPool      m_pool{};
+  VkDescriptorSet       m_set{};
+  VkPipelineLayout      m_pipelineLayout{};
+  uint32_t              m_capacity{0};
+  std::vector<uint32_t> m_freeSlots;
+};
+
+}  // namespace nvvk
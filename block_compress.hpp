@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include "gl_vk.hpp"
+#include "gpu_timer.hpp"
+#include "interop_state.hpp"
+#include "pipeline_cache.hpp"
+#include "spirv.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
+#include "nvvk/images_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "block_compress_comp_bc1_spv.h"
+#include "block_compress_comp_bc4_spv.h"
+#include "block_compress_comp_bc7_spv.h"
+
+// Compression of an interop image into a second one, which OpenGL samples instead
+struct BlockCompressSettings
+{
+  enum Format : int
+  {
+    eNone,
+    eBC1,  // RGB, 4 bits per pixel
+    eBC4,  // Luminance, 4 bits per pixel
+    eBC7,  // RGBA, 8 bits per pixel (mode 6 only)
+  };
+
+  enum Preset : int
+  {
+    eFast,     // Bounding box of each block
+    eQuality,  // Principal axis of each block, refined with least squares
+  };
+
+  Format format{eNone};
+  Preset preset{eFast};
+
+  bool operator==(const BlockCompressSettings&) const = default;
+};
+
+// Must match the push_constant block of shaders/block_compress.comp
+struct BlockCompressPushConstants
+{
+  uint32_t quality;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Block compression of an RGBA8 image on the GPU, into a BC interop texture: OpenGL samples 4 to 8
+// times less memory than the RGBA8 image, which is worth it for images displayed for many frames.
+// A compute shader encodes each 4x4 block into a texel of an R32G32 (BC1, BC4) or R32G32B32A32
+// (BC7) image of blocks, which is then copied into the compressed image: storage images cannot be
+// compressed. The compressed image is left in TRANSFER_DST for OpenGL, see state().
+//
+class BlockCompressPass
+{
+public:
+  // BC formats need textureCompressionBC, which nvvk::Context enables when supported
+  static bool isSupported(VkPhysicalDevice physicalDevice)
+  {
+    VkPhysicalDeviceFeatures features{};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    if(!features.textureCompressionBC)
+      return false;
+    for(BlockCompressSettings::Format format : {BlockCompressSettings::eBC1, BlockCompressSettings::eBC4, BlockCompressSettings::eBC7})
+    {
+      VkFormatProperties properties{};
+      vkGetPhysicalDeviceFormatProperties(physicalDevice, vkFormat(format), &properties);
+      const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+      if((properties.optimalTilingFeatures & needed) != needed)
+        return false;
+    }
+    return true;
+  }
+
+  static VkFormat vkFormat(BlockCompressSettings::Format format)
+  {
+    switch(format)
+    {
+      case BlockCompressSettings::eBC1:
+        return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+      case BlockCompressSettings::eBC4:
+        return VK_FORMAT_BC4_UNORM_BLOCK;
+      case BlockCompressSettings::eBC7:
+        return VK_FORMAT_BC7_UNORM_BLOCK;
+      default:
+        return VK_FORMAT_UNDEFINED;
+    }
+  }
+
+  static GLenum glFormat(BlockCompressSettings::Format format)
+  {
+    switch(format)
+    {
+      case BlockCompressSettings::eBC1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+      case BlockCompressSettings::eBC4:
+        return GL_COMPRESSED_RED_RGTC1;
+      case BlockCompressSettings::eBC7:
+        return GL_COMPRESSED_RGBA_BPTC_UNORM;
+      default:
+        return GL_NONE;
+    }
+  }
+
+  // Bytes of a 4x4 block
+  static uint32_t blockSize(BlockCompressSettings::Format format)
+  {
+    return format == BlockCompressSettings::eBC7 ? 16 : 8;
+  }
+
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, const ComputePipelineCache& pipelineCache, uint32_t queueFamily)
+  {
+    m_device      = device;
+    m_queueFamily = queueFamily;
+    m_timer.init(device, physicalDevice, queueFamily);
+
+    m_descriptors.init(device);
+    m_descriptors.addBinding(0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.initLayout();
+    m_descriptors.initPool(1);
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(BlockCompressPushConstants)};
+    m_descriptors.initPipeLayout(1, &pushConstants);
+
+    m_pipelines[BlockCompressSettings::eBC1] =
+        createPipeline(pipelineCache, makeSpirvShader("shaders/block_compress_comp_bc1.spv", block_compress_comp_bc1_spv));
+    m_pipelines[BlockCompressSettings::eBC4] =
+        createPipeline(pipelineCache, makeSpirvShader("shaders/block_compress_comp_bc4.spv", block_compress_comp_bc4_spv));
+    m_pipelines[BlockCompressSettings::eBC7] =
+        createPipeline(pipelineCache, makeSpirvShader("shaders/block_compress_comp_bc7.spv", block_compress_comp_bc7_spv));
+  }
+
+  void deinit(nvvk::ResourceAllocator& alloc)
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+    destroyImages(alloc);
+    for(VkPipeline pipeline : m_pipelines)
+      vkDestroyPipeline(m_device, pipeline, nullptr);
+    m_descriptors.deinit();
+    m_timer.deinit();
+    m_device = VK_NULL_HANDLE;
+  }
+
+  bool isValid() const { return m_device != VK_NULL_HANDLE; }
+
+  // (Re)creates the compressed texture for images of `extent` in `format`, and its image of blocks.
+  // The previous submission using them must be complete.
+  void resize(nvvk::ResourceAllocator& alloc, VkExtent2D extent, BlockCompressSettings::Format format)
+  {
+    destroyImages(alloc);
+    m_extent = extent;
+    m_format = format;
+    m_blocks = {(extent.width + 3) / 4, (extent.height + 3) / 4};
+
+    VkImageCreateInfo blockInfo{.sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                                .imageType   = VK_IMAGE_TYPE_2D,
+                                .format      = blockSize(format) == 16 ? VK_FORMAT_R32G32B32A32_UINT : VK_FORMAT_R32G32_UINT,
+                                .extent      = {m_blocks.width, m_blocks.height, 1},
+                                .mipLevels   = 1,
+                                .arrayLayers = 1,
+                                .samples     = VK_SAMPLE_COUNT_1_BIT,
+                                .tiling      = VK_IMAGE_TILING_OPTIMAL,
+                                .usage       = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+    nvvk::Image           blockImage = alloc.createImage(blockInfo);
+    VkImageViewCreateInfo blockView  = nvvk::makeImageViewCreateInfo(blockImage.image, blockInfo);
+    m_blockImage                     = alloc.createTexture(blockImage, blockView);
+    m_blockImageReady                = false;
+
+    VkImageCreateInfo compressedInfo = blockInfo;
+    compressedInfo.format            = vkFormat(format);
+    compressedInfo.extent            = {extent.width, extent.height, 1};
+    compressedInfo.usage             = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    nvvk::Image           image      = alloc.createImage(compressedInfo);
+    VkImageViewCreateInfo ivInfo     = nvvk::makeImageViewCreateInfo(image.image, compressedInfo);
+    m_compressed.texVk               = alloc.createTexture(image, ivInfo, {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO});
+    m_compressed.imgSize             = extent;
+    createTextureGL(alloc, m_compressed, glFormat(format), GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
+    // Luminance, displayed in gray
+    if(format == BlockCompressSettings::eBC4)
+    {
+      const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+      glTextureParameteriv(m_compressed.oglId, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    m_state.init(m_compressed.texVk.image, m_compressed.oglId, VK_IMAGE_LAYOUT_UNDEFINED, m_queueFamily);
+
+    const VkDescriptorImageInfo blocks{.imageView = m_blockImage.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkWriteDescriptorSet  write = m_descriptors.makeWrite(0, 1, &blocks);
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+  }
+
+  void destroyImages(nvvk::ResourceAllocator& alloc)
+  {
+    m_compressed.destroy(alloc);
+    alloc.destroy(m_blockImage);
+    m_compressed = {};
+    m_blockImage = {};
+    m_format     = BlockCompressSettings::eNone;
+    m_sourceView = VK_NULL_HANDLE;
+  }
+
+  BlockCompressSettings::Format format() const { return m_format; }
+  VkExtent2D                    extent() const { return m_extent; }
+
+  // OpenGL texture of the compressed image, and its layout and owner for the interop batch
+  GLuint                   texture() const { return m_compressed.oglId; }
+  nvvk::InteropImageState& state() { return m_state; }
+
+  // Memory of the compressed image, and of the RGBA8 image it replaces
+  VkDeviceSize compressedBytes() const { return VkDeviceSize(m_blocks.width) * m_blocks.height * blockSize(m_format); }
+  VkDeviceSize sourceBytes() const { return VkDeviceSize(m_extent.width) * m_extent.height * 4; }
+
+  // Records the compression of `sourceView`, an RGBA8 image in GENERAL written by compute shaders
+  // before, of the size given to resize()
+  void record(VkCommandBuffer cmd, VkImageView sourceView, BlockCompressSettings::Preset preset)
+  {
+    if(sourceView != m_sourceView)
+    {
+      const VkDescriptorImageInfo source{.imageView = sourceView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+      const VkWriteDescriptorSet  write = m_descriptors.makeWrite(0, 0, &source);
+      vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+      m_sourceView = sourceView;
+    }
+
+    // The source is read once written, and the image of blocks gets its layout once
+    VkMemoryBarrier writeToRead{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
+    VkImageMemoryBarrier initLayout{.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                    .dstAccessMask    = VK_ACCESS_SHADER_WRITE_BIT,
+                                    .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
+                                    .newLayout        = VK_IMAGE_LAYOUT_GENERAL,
+                                    .image            = m_blockImage.image,
+                                    .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &writeToRead, 0, nullptr, m_blockImageReady ? 0 : 1, &initLayout);
+    m_blockImageReady = true;
+
+    m_timer.begin(cmd);
+    const BlockCompressPushConstants pushc{.quality = preset == BlockCompressSettings::eQuality ? 1u : 0u};
+    const VkDescriptorSet            descriptorSet = m_descriptors.getSet(0);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[m_format]);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_descriptors.getPipeLayout(), 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cmd, m_descriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+    vkCmdDispatch(cmd, (m_blocks.width + 7) / 8, (m_blocks.height + 7) / 8, 1);
+
+    // Blocks -> compressed image: with a compressed destination, the extent is in texels of the source
+    VkMemoryBarrier blocksToCopy{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                 .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                                 .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &blocksToCopy,
+                         0, nullptr, 0, nullptr);
+    m_state.acquireVk(cmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    VkImageCopy region{.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                       .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                       .extent         = {m_blocks.width, m_blocks.height, 1}};
+    vkCmdCopyImage(cmd, m_blockImage.image, VK_IMAGE_LAYOUT_GENERAL, m_compressed.texVk.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    m_timer.end(cmd);
+    m_state.releaseVk(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+  }
+
+  // GPU time of the last compression measured, with the copy; negative if there is none
+  double lastGpuMs() const { return m_timer.lastMs(); }
+
+private:
+  VkPipeline createPipeline(const ComputePipelineCache& pipelineCache, const SpirvShader& shader)
+  {
+    VkPipelineShaderStageCreateInfo stage{.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                          .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                          .module = createShaderModule(m_device, shader),
+                                          .pName  = "main"};
+    VkComputePipelineCreateInfo pipelineInfo{.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                             .stage  = stage,
+                                             .layout = m_descriptors.getPipeLayout()};
+    VkPipeline pipeline = pipelineCache.createCompute(pipelineInfo, shader.filename);
+    vkDestroyShaderModule(m_device, stage.module, nullptr);
+    return pipeline;
+  }
+
+  VkDevice                      m_device{};
+  uint32_t                      m_queueFamily{0};
+  nvvk::DescriptorSetContainer  m_descriptors;
+  VkPipeline                    m_pipelines[4]{};  // By BlockCompressSettings::Format, none for eNone
+  BlockCompressSettings::Format m_format{BlockCompressSettings::eNone};
+  VkExtent2D                    m_extent{0, 0};
+  VkExtent2D                    m_blocks{0, 0};  // Size of the image of blocks
+  nvvk::Texture                 m_blockImage;
+  bool                          m_blockImageReady{false};  // In GENERAL
+  nvvk::Texture2DVkGL           m_compressed;              // Sampled by OpenGL
+  nvvk::InteropImageState       m_state;                   // Layout and owner of m_compressed
+  VkImageView                   m_sourceView{};            // Of the descriptor set
+  nvvk::GpuTimer                m_timer;
+};
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+
+#include "gpu_timer.hpp"
+#include "pipeline_cache.hpp"
+#include "spirv.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
+#include "nvvk/images_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "blur_comp_fp16_spv.h"
+#include "blur_comp_fp32_spv.h"
+#include "blur_naive_comp_spv.h"
+
+// Blur applied to an interop image after its kernel
+struct BlurSettings
+{
+  enum Mode : int
+  {
+    eSeparable,  // Horizontal then vertical pass, lines loaded in shared memory
+    eNaive,      // Direct 2D kernel, the reference
+    eFft,        // Convolution in the frequency domain, see FftConvolutionPass
+  };
+
+  uint32_t radius{0};  // In pixels, 0 for no blur, at most BlurPass::kMaxRadius (FftConvolutionPass::kMaxRadius for eFft)
+  bool     gaussian{true};
+  Mode     mode{eSeparable};
+  bool     fp16{false};  // Accumulate in float16, separable mode only
+
+  bool operator==(const BlurSettings&) const = default;
+};
+
+// Must match the push_constant block of shaders/blur.comp and shaders/blur_naive.comp
+struct BlurPushConstants
+{
+  uint32_t radius;
+  uint32_t vertical;
+  uint32_t gaussian;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Blur of an RGBA8 storage image in place, through an intermediate image of the same size:
+// - separable: a horizontal pass into the intermediate image, and a vertical one back. Each
+//   workgroup loads a segment of a line and its apron once in shared memory, instead of each pixel
+//   reading its 2 * radius + 1 neighbors from the image.
+// - naive: the 2D kernel into the intermediate image, then a copy back (blur.comp with radius 0)
+// The GPU time of the blur itself, without the copy, is measured with timestamps.
+//
+class BlurPass
+{
+public:
+  static constexpr uint32_t kMaxRadius = 64;   // MAX_RADIUS of the shaders
+  static constexpr uint32_t kLineSize  = 256;  // LINE_SIZE of shaders/blur.comp
+
+  // fp16 accumulation needs shaderFloat16, which nvvk::Context enables when supported
+  static bool isFp16Supported(VkPhysicalDevice physicalDevice)
+  {
+    VkPhysicalDeviceVulkan12Features features12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2 features{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &features12};
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    return features12.shaderFloat16 == VK_TRUE;
+  }
+
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, const ComputePipelineCache& pipelineCache, uint32_t queueFamily)
+  {
+    m_device = device;
+    m_timer.init(device, physicalDevice, queueFamily);
+
+    // Set 0: target -> intermediate, set 1: intermediate -> target
+    m_descriptors.init(device);
+    m_descriptors.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.initLayout();
+    m_descriptors.initPool(2);
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(BlurPushConstants)};
+    m_descriptors.initPipeLayout(1, &pushConstants);
+
+    m_separable   = createPipeline(pipelineCache, makeSpirvShader("shaders/blur_comp_fp32.spv", blur_comp_fp32_spv));
+    m_naive       = createPipeline(pipelineCache, makeSpirvShader("shaders/blur_naive_comp.spv", blur_naive_comp_spv));
+    m_separable16 = isFp16Supported(physicalDevice) ?
+                        createPipeline(pipelineCache, makeSpirvShader("shaders/blur_comp_fp16.spv", blur_comp_fp16_spv)) :
+                        VK_NULL_HANDLE;
+  }
+
+  void deinit(nvvk::ResourceAllocator& alloc)
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+    destroyImages(alloc);
+    vkDestroyPipeline(m_device, m_separable, nullptr);
+    vkDestroyPipeline(m_device, m_separable16, nullptr);
+    vkDestroyPipeline(m_device, m_naive, nullptr);
+    m_descriptors.deinit();
+    m_timer.deinit();
+    m_device = VK_NULL_HANDLE;
+  }
+
+  bool isValid() const { return m_device != VK_NULL_HANDLE; }
+
+  // The intermediate image, of the size of the images to blur
+  void resize(nvvk::ResourceAllocator& alloc, VkExtent2D extent)
+  {
+    destroyImages(alloc);
+    VkImageCreateInfo imageInfo{.sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                                .imageType   = VK_IMAGE_TYPE_2D,
+                                .format      = VK_FORMAT_R8G8B8A8_UNORM,
+                                .extent      = {extent.width, extent.height, 1},
+                                .mipLevels   = 1,
+                                .arrayLayers = 1,
+                                .samples     = VK_SAMPLE_COUNT_1_BIT,
+                                .tiling      = VK_IMAGE_TILING_OPTIMAL,
+                                .usage       = VK_IMAGE_USAGE_STORAGE_BIT};
+    nvvk::Image           image  = alloc.createImage(imageInfo);
+    VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageInfo);
+    m_intermediate               = alloc.createTexture(image, ivInfo);
+    m_extent                     = extent;
+    m_intermediateReady          = false;
+    m_targetView                 = VK_NULL_HANDLE;
+  }
+
+  void destroyImages(nvvk::ResourceAllocator& alloc)
+  {
+    alloc.destroy(m_intermediate);
+    m_intermediate = {};
+  }
+
+  // Records the blur of `targetView`, in GENERAL and written by compute shaders before
+  void record(VkCommandBuffer cmd, VkImageView targetView, const BlurSettings& settings)
+  {
+    if(targetView != m_targetView)
+      updateDescriptors(targetView);
+
+    // The kernel's writes are read, and the intermediate image gets its layout once
+    VkMemoryBarrier writeToRead{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    VkImageMemoryBarrier initLayout{.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                    .dstAccessMask    = VK_ACCESS_SHADER_WRITE_BIT,
+                                    .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
+                                    .newLayout        = VK_IMAGE_LAYOUT_GENERAL,
+                                    .image            = m_intermediate.image,
+                                    .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &writeToRead, 0, nullptr, m_intermediateReady ? 0 : 1, &initLayout);
+    m_intermediateReady = true;
+
+    BlurPushConstants pushc{.radius = std::min(settings.radius, kMaxRadius), .gaussian = settings.gaussian ? 1u : 0u};
+    m_timer.begin(cmd);
+    if(settings.mode == BlurSettings::eNaive)
+    {
+      dispatch(cmd, m_naive, 0, pushc, (m_extent.width + 15) / 16, (m_extent.height + 15) / 16);
+      m_timer.end(cmd);
+      // Copy back
+      barrier(cmd);
+      pushc.radius = 0;
+      dispatchLines(cmd, m_separable, 1, pushc);
+    }
+    else
+    {
+      const VkPipeline pipeline = (settings.fp16 && m_separable16 != VK_NULL_HANDLE) ? m_separable16 : m_separable;
+      dispatchLines(cmd, pipeline, 0, pushc);
+      barrier(cmd);
+      pushc.vertical = 1;
+      dispatchLines(cmd, pipeline, 1, pushc);
+      m_timer.end(cmd);
+    }
+  }
+
+  // GPU time of the last blur measured, negative if there is none
+  double lastGpuMs() const { return m_timer.lastMs(); }
+
+private:
+  VkPipeline createPipeline(const ComputePipelineCache& pipelineCache, const SpirvShader& shader)
+  {
+    VkPipelineShaderStageCreateInfo stage{.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                          .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                          .module = createShaderModule(m_device, shader),
+                                          .pName  = "main"};
+    VkComputePipelineCreateInfo pipelineInfo{.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                             .stage  = stage,
+                                             .layout = m_descriptors.getPipeLayout()};
+    VkPipeline pipeline = pipelineCache.createCompute(pipelineInfo, shader.filename);
+    vkDestroyShaderModule(m_device, stage.module, nullptr);
+    return pipeline;
+  }
+
+  void updateDescriptors(VkImageView targetView)
+  {
+    const VkDescriptorImageInfo target{.imageView = targetView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkDescriptorImageInfo intermediate{.imageView = m_intermediate.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkWriteDescriptorSet writes[4] = {m_descriptors.makeWrite(0, 0, &target), m_descriptors.makeWrite(0, 1, &intermediate),
+                                            m_descriptors.makeWrite(1, 0, &intermediate), m_descriptors.makeWrite(1, 1, &target)};
+    vkUpdateDescriptorSets(m_device, 4, writes, 0, nullptr);
+    m_targetView = targetView;
+  }
+
+  // Between passes: the next one reads what the previous wrote, and writes what it read
+  static void barrier(VkCommandBuffer cmd)
+  {
+    VkMemoryBarrier barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  void dispatch(VkCommandBuffer cmd, VkPipeline pipeline, uint32_t set, const BlurPushConstants& pushc, uint32_t x, uint32_t y)
+  {
+    const VkDescriptorSet descriptorSet = m_descriptors.getSet(set);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_descriptors.getPipeLayout(), 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cmd, m_descriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+    vkCmdDispatch(cmd, x, y, 1);
+  }
+
+  // blur.comp: one workgroup per segment of kLineSize pixels of each row, or column
+  void dispatchLines(VkCommandBuffer cmd, VkPipeline pipeline, uint32_t set, const BlurPushConstants& pushc)
+  {
+    const uint32_t length = pushc.vertical ? m_extent.height : m_extent.width;
+    const uint32_t lines  = pushc.vertical ? m_extent.width : m_extent.height;
+    dispatch(cmd, pipeline, set, pushc, (length + kLineSize - 1) / kLineSize, lines);
+  }
+
+  VkDevice                     m_device{};
+  nvvk::DescriptorSetContainer m_descriptors;
+  VkPipeline                   m_separable{};
+  VkPipeline                   m_separable16{};  // When shaderFloat16 is supported
+  VkPipeline                   m_naive{};
+  nvvk::Texture                m_intermediate;
+  VkExtent2D                   m_extent{0, 0};
+  bool                         m_intermediateReady{false};  // In GENERAL
+  VkImageView                  m_targetView{};              // Of the descriptor sets
+  nvvk::GpuTimer               m_timer;
+};
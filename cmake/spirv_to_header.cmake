@@ -0,0 +1,26 @@
+# Converts a SPIR-V binary into a C++ header holding its words as a constexpr array.
+# Usage: cmake -DSPV=<file.spv> -DHEADER=<file.h> -DSYMBOL=<name> -P spirv_to_header.cmake
+
+file(READ ${SPV} _HEX HEX)
+string(LENGTH "${_HEX}" _HEX_LENGTH)
+math(EXPR _REMAINDER "${_HEX_LENGTH} % 8")
+if(_HEX_LENGTH EQUAL 0 OR NOT _REMAINDER EQUAL 0)
+  message(FATAL_ERROR "${SPV} is not a valid SPIR-V binary")
+endif()
+
+# SPIR-V words are stored little-endian: bytes 03 02 23 07 are the word 0x07230203
+string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1u, " _WORDS "${_HEX}")
+# 8 words per line (CMake regular expressions have no {n} repetition)
+string(REPEAT "0x[0-9a-f]+u, " 8 _LINE)
+string(REGEX REPLACE "(${_LINE})" "\\1\n    " _WORDS "${_WORDS}")
+
+get_filename_component(_SPV_NAME ${SPV} NAME)
+file(WRITE ${HEADER}
+  "// Generated from ${_SPV_NAME} by cmake/spirv_to_header.cmake, do not edit\n"
+  "#pragma once\n"
+  "\n"
+  "#include <cstdint>\n"
+  "\n"
+  "constexpr uint32_t ${SYMBOL}[] = {\n"
+  "    ${_WORDS}\n"
+  "};\n")
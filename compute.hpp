@@ -20,41 +20,171 @@
 
 #pragma once
 
-#include <chrono>
+#include <algorithm>
+#include <cassert>
+#include <vector>
 #include "gl_vk.hpp"
-#include "nvh/fileoperations.hpp"
+#include "gl_vk_sparse.hpp"
+#include "bindless_table.hpp"
+#include "block_compress.hpp"
+#include "blur.hpp"
+#include "exposure.hpp"
+#include "fft.hpp"
+#include "gpu_timer.hpp"
+#include "interop_registry.hpp"
+#include "pipeline_cache.hpp"
+#include "sdf.hpp"
+#include "shader_object_cache.hpp"
+#include "spirv.hpp"
+#include "tonemap.hpp"
 #include "nvvk/commands_vk.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
 #include "nvvk/images_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
 #include "nvvk/shaders_vk.hpp"
 
-extern std::vector<std::string> defaultSearchPaths;
+#include "diffusion_comp_spv.h"
+#include "shader_comp_variants.h"
 
-static const VkFormat kTextureFormat = VK_FORMAT_R8G8B8A8_UNORM;
+static const SpirvShader kDiffusionShader = makeSpirvShader("shaders/diffusion_comp.spv", diffusion_comp_spv);
+
+// Whether the device can run a variant of shader.comp: shaderFloat16 for fp16 (nvvk::Context enables
+// all supported core features), and the workgroup limits
+inline bool isShaderVariantSupported(VkPhysicalDevice physicalDevice, const ComputeShaderVariant& variant)
+{
+  VkPhysicalDeviceVulkan12Features features12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  VkPhysicalDeviceFeatures2 features{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &features12};
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  const VkPhysicalDeviceLimits& limits = properties.limits;
+
+  return (!variant.fp16 || features12.shaderFloat16)
+         && variant.workgroupSize * variant.workgroupSize <= limits.maxComputeWorkGroupInvocations
+         && variant.workgroupSize <= limits.maxComputeWorkGroupSize[0] && variant.workgroupSize <= limits.maxComputeWorkGroupSize[1];
+}
+
+// Best supported variant of shader.comp for the image format, writing through the bindless table or
+// not: fp16 color math when possible, and the largest workgroup
+inline const ComputeShaderVariant& selectShaderVariant(VkPhysicalDevice physicalDevice, VkFormat format, bool bindless)
+{
+  const ComputeShaderVariant* best = nullptr;
+  for(const ComputeShaderVariant& variant : shader_comp_variants)
+  {
+    if(variant.format != format || variant.bindless != bindless || !isShaderVariantSupported(physicalDevice, variant))
+      continue;
+    if(best == nullptr || variant.workgroupSize > best->workgroupSize
+       || (variant.workgroupSize == best->workgroupSize && variant.fp16 && !best->fp16))
+      best = &variant;
+  }
+  assert(best != nullptr && "no shader variant for this format");
+  return *best;
+}
+
+static const VkFormat kTextureFormat    = VK_FORMAT_R8G8B8A8_UNORM;
+static const VkFormat kHdrTextureFormat = VK_FORMAT_R16G16B16A16_SFLOAT;  // See ComputeImageVk::setHdr()
+
+// OpenGL internal format of the textures, for one of the formats above
+inline GLenum glTextureFormat(VkFormat format)
+{
+  return format == kHdrTextureFormat ? GL_RGBA16F : GL_RGBA8;
+}
+
+// Parameters of the procedural kernel, each producer can have its own set
+struct KernelParams
+{
+  float speed{0.5f};            // Speed of the rings
+  float scale{5.0f};            // Zoom of the pattern
+  float hue{0.0f};              // Color rotation, in radians
+  float center[2]{0.5f, 0.3f};  // Center of the pattern, in UV space
+  float diffusionRate{0.2f};    // Ping-pong kernel: fraction of the Laplacian added per iteration
+  float diffusionDecay{0.99f};  // Ping-pong kernel: fade per iteration
+  float hdrIntensity{4.0f};     // HDR images: peak of the colors, which RGBA8 would clamp at 1
+};
+
+// Optional device extensions the producers use when enabled on the device
+struct ComputeFeatures
+{
+  bool pushDescriptor{false};    // VK_KHR_push_descriptor: no descriptor pool or set, see createDescriptors()
+  bool bindless{false};          // Descriptor indexing: the image is a slot of the shared BindlessImageTable
+  bool shaderObject{false};      // VK_EXT_shader_object: a shader object instead of a pipeline
+  bool pipelineFeedback{false};  // VK_EXT_pipeline_creation_feedback: see ComputePipelineCache
+};
+
+// Objects shared by all producers, the pipeline cache and those needed by some of the ComputeFeatures
+struct ComputeSharedResources
+{
+  nvvk::BindlessImageTable* bindlessTable{nullptr};      // For ComputeFeatures::bindless
+  nvvk::ShaderObjectCache*  shaderObjectCache{nullptr};  // For ComputeFeatures::shaderObject
+  ComputePipelineCache*     pipelineCache{nullptr};      // Of all compute pipelines
+};
+
+// Must match the push_constant block of shaders/shader.comp
+struct ComputePushConstants
+{
+  float    iTime;
+  float    speed;
+  float    scale;
+  float    hue;
+  float    center[2];
+  uint32_t tileOffset[2];      // Position of this image in the logical image
+  uint32_t logicalSize[2];     // Size of the logical image
+  uint32_t dispatchOffset[2];  // First pixel written by the dispatch
+  uint32_t imageIndex;         // Slot of the image in the bindless table
+  float    intensity;          // Peak of the colors
+};
+
+static constexpr uint32_t kDiffusionGroupSize = 16;  // WORKGROUP_SIZE of shaders/diffusion.comp
+
+// Must match the push_constant block of shaders/diffusion.comp
+struct DiffusionPushConstants
+{
+  float    iTime;
+  float    rate;
+  float    decay;
+  float    hue;
+  float    center[2];
+  uint32_t tileOffset[2];
+  uint32_t logicalSize[2];
+  uint32_t reset;  // The previous image is undefined
+};
 
 class ComputeImageVk
 {
 
 public:
   ComputeImageVk() = default;
+
+  // Must be set before setup()
+  void setSharedResources(const ComputeSharedResources& shared)
+  {
+    m_bindless      = shared.bindlessTable;
+    m_shaderCache   = shared.shaderObjectCache;
+    m_pipelineCache = shared.pipelineCache;
+  }
+
   void setup(const VkDevice&                         device,
              const VkPhysicalDevice&                 physicalDevice,
              uint32_t                                queueIdxGraphic,
              uint32_t                                queueIdxCompute,
-             nvvk::ExportResourceAllocatorDedicated& alloc)
+             uint32_t                                queueIndex,
+             nvvk::ExportResourceAllocatorDedicated& alloc,
+             const ComputeFeatures&                  features)
   {
+    assert(!features.bindless || m_bindless != nullptr);
+    assert(!features.shaderObject || m_shaderCache != nullptr);
+    assert(m_pipelineCache != nullptr);
+    m_features        = features;
     m_device          = device;
     m_physicalDevice  = physicalDevice;
     m_queueIdxGraphic = queueIdxGraphic;
     m_queueIdxCompute = queueIdxCompute;
-    VkPipelineCacheCreateInfo pipelineCacheInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
-    NVVK_CHECK(vkCreatePipelineCache(device, &pipelineCacheInfo, nullptr, &m_pipelineCache));
 
     VkFenceCreateInfo finfo{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .flags = VK_FENCE_CREATE_SIGNALED_BIT};
     NVVK_CHECK(vkCreateFence(device, &finfo, nullptr, &m_fence));
 
     // Create a compute capable device queue
-    vkGetDeviceQueue(m_device, m_queueIdxCompute, 0, &m_queue);
+    vkGetDeviceQueue(m_device, m_queueIdxCompute, queueIndex, &m_queue);
     // Separate command pool as queue family for compute may be different than graphics
     VkCommandPoolCreateInfo commandPoolInfo{.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
                                             .flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
@@ -63,6 +193,8 @@ public:
 
     createSemaphores();
     createDescriptors();
+    m_computeTimer.init(device, physicalDevice, queueIdxCompute);
+    m_variant = &selectShaderVariant(physicalDevice, format(), m_features.bindless);
     createPipelines();
 
     m_alloc = &alloc;
@@ -70,7 +202,7 @@ public:
 
   VkDevice                                m_device{};
   VkQueue                                 m_queue{};
-  VkPipelineCache                         m_pipelineCache{};
+  ComputePipelineCache*                   m_pipelineCache = nullptr;  // Shared by all producers
   VkCommandPool                           m_commandPool{};
   nvvk::Texture2DVkGL                     m_textureTarget;
   VkDescriptorPool                        m_descriptorPool{};
@@ -84,95 +216,185 @@ public:
   VkPhysicalDevice                        m_physicalDevice{};
   VkFence                                 m_fence{};
   nvvk::ExportResourceAllocatorDedicated* m_alloc = nullptr;
-
-  struct Semaphores
-  {
-    VkSemaphore vkReady;
-    VkSemaphore vkComplete;
-    GLuint      glReady;
-    GLuint      glComplete;
-  } m_semaphores{};
+  KernelParams                            m_params;
+  VkOffset2D                              m_tileOffset{0, 0};   // Where this image sits in a tiled image
+  VkExtent2D                              m_logicalSize{0, 0};  // Size of the tiled image, 0 when not tiled
+  VkRect2D                                m_visibleRegion{};    // Pixels of this image that are displayed
+  const nvvk::SparseInteropSupport*       m_sparse = nullptr;   // Set to create a sparse-resident image
+  nvvk::SparseTexture2DVkGL               m_sparseTexture;
+  VkSemaphore                             m_sparseBound{};      // Signaled when page bindings are done
+  bool                                    m_sparseBindPending{false};
+  const ComputeShaderVariant*             m_variant = nullptr;  // Permutation of shader.comp in use
+  nvvk::InteropImageState                 m_targetState;        // Layout and owner of m_textureTarget
+  ComputeFeatures                         m_features;
+  nvvk::BindlessImageTable*               m_bindless = nullptr;  // Shared table, used when m_features.bindless
+  uint32_t                                m_bindlessSlot = nvvk::BindlessImageTable::kInvalidSlot;
+  nvvk::ShaderObjectCache*                m_shaderCache = nullptr;  // Shared, used when m_features.shaderObject
+  VkShaderEXT                             m_shader{};               // Instead of m_pipeline with shader objects
+
+  // Ping-pong pair, see setIterations(). m_textureTarget is the image written last, the one OpenGL gets.
+  uint32_t                     m_iterations{0};         // Per frame, 0 for shader.comp
+  nvvk::Texture2DVkGL          m_previousTarget;        // The other image, Vulkan keeps it
+  nvvk::InteropImageState      m_previousState;         // Layout and owner of m_previousTarget
+  uint32_t                     m_pingPongParity{0};     // Set of m_pingPongDescriptors reading m_textureTarget
+  bool                         m_pingPongReset{false};  // The pair is new, its content undefined
+  nvvk::DescriptorSetContainer m_pingPongDescriptors;   // Set i reads image i of the pair, writes the other
+  VkPipeline                   m_pingPongPipeline{};
+
+  BlurPass           m_blur;          // Created by the first setBlur() with a radius
+  FftConvolutionPass m_fft;           // Created by the first setBlur() in eFft mode
+  BlurSettings       m_blurSettings;  // Applied to m_textureTarget after the kernel
+
+  ExposurePass     m_exposure;          // Created by the first setExposure() enabling it
+  ExposureSettings m_exposureSettings;  // Computed from m_textureTarget after the blur
+  float            m_lastTime{0.f};     // Animation time of the previous frame
+
+  bool            m_hdr{false};        // RGBA16F image, see setHdr()
+  ToneMapPass     m_toneMap;           // Created by the first setToneMapping() in compute
+  ToneMapSettings m_toneMapSettings;   // Of the HDR image, in compute or by OpenGL
+  nvvk::GpuTimer  m_computeTimer;      // Kernel and compute tone mapping
+
+  BlockCompressPass     m_compress;          // Created by the first setBlockCompression() with a format
+  BlockCompressSettings m_compressSettings;  // OpenGL displays the compressed image when set
+
+  SdfPass     m_sdf;          // Created by the first setSdf() enabling it
+  SdfSettings m_sdfSettings;  // Distance field of m_textureTarget after the blur
+
+  using Semaphores = nvvk::InteropSemaphores;
+  Semaphores m_semaphores;
 
   void destroy()
   {
     vkQueueWaitIdle(m_queue);
-    m_textureTarget.destroy(*m_alloc);
+    destroyTextureTarget();
+    m_blur.deinit(*m_alloc);
+    m_fft.deinit(*m_alloc);
+    m_exposure.deinit(*m_alloc);
+    m_toneMap.deinit();
+    m_compress.deinit(*m_alloc);
+    m_sdf.deinit(*m_alloc);
+    m_computeTimer.deinit();
+    vkDestroySemaphore(m_device, m_sparseBound, nullptr);
     vkFreeCommandBuffers(m_device, m_commandPool, 1, &m_commandBuffer);
     vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
-    vkDestroySemaphore(m_device, m_semaphores.vkReady, nullptr);
-    vkDestroySemaphore(m_device, m_semaphores.vkComplete, nullptr);
-    vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+    m_semaphores.destroy(m_device);
     vkDestroyFence(m_device, m_fence, nullptr);
 
-    // Clean up used Vulkan resources
-    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    // Clean up used Vulkan resources; the bindless pipeline layout belongs to the table
+    if(!m_features.bindless)
+      vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
     vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
-    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    destroyComputePipeline();
+    destroyPingPong();
     vkDestroyCommandPool(m_device, m_commandPool, nullptr);
   }
 
+  // Move the producer to another queue of the same family; the command pool stays valid
+  void setQueue(uint32_t queueIndex)
+  {
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    vkGetDeviceQueue(m_device, m_queueIdxCompute, queueIndex, &m_queue);
+  }
+
   void update(VkExtent2D extent)
   {
-    m_textureTarget.destroy(*m_alloc);
-    m_textureTarget = prepareTextureTarget(VK_IMAGE_LAYOUT_GENERAL, extent, kTextureFormat);
-    createTextureGL(*m_alloc, m_textureTarget, GL_RGBA8, GL_LINEAR, GL_LINEAR, GL_REPEAT);
+    // The previous image may still be written by the last submission
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    destroyTextureTarget();
+    m_textureTarget = prepareTextureTarget(extent, format());
+    // Clamp, so that tiles of a tiled image do not bleed into each other when filtered
+    if(!m_sparse)
+      createTextureGL(*m_alloc, m_textureTarget, glTextureFormat(format()), GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
+    // The transition to GENERAL is recorded in the next compute command buffer, not submitted here
+    m_targetState.init(m_textureTarget.texVk.image, m_textureTarget.oglId, VK_IMAGE_LAYOUT_UNDEFINED, m_queueIdxCompute);
+    m_visibleRegion = {{0, 0}, extent};
+    if(m_blur.isValid())
+      m_blur.resize(*m_alloc, extent);
+    if(m_fft.isValid() && FftConvolutionPass::fits(m_physicalDevice, extent, m_blurSettings.radius))
+      m_fft.resize(*m_alloc, extent, m_blurSettings.radius);
+    if(m_compress.isValid() && m_compressSettings.format != BlockCompressSettings::eNone)
+      m_compress.resize(*m_alloc, extent, m_compressSettings.format);
+    if(m_sdf.isValid())
+      m_sdf.resize(*m_alloc, extent);
+    if(m_exposure.isValid())
+      m_exposure.invalidate();
+    if(m_toneMap.isValid())
+      m_toneMap.invalidate();
+
+    if(m_iterations > 0)
+    {
+      assert(!m_sparse && "ping-pong images are not sparse");
+      m_previousTarget = prepareTextureTarget(extent, format());
+      createTextureGL(*m_alloc, m_previousTarget, glTextureFormat(format()), GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
+      m_previousState.init(m_previousTarget.texVk.image, m_previousTarget.oglId, VK_IMAGE_LAYOUT_UNDEFINED, m_queueIdxCompute);
+      updatePingPongDescriptors();
+    }
 
     updateDescriptors();
   }
 
-  void createSemaphores()
+  // Sparse images are not owned by the allocator
+  void destroyTextureTarget()
   {
-    glGenSemaphoresEXT(1, &m_semaphores.glReady);
-    glGenSemaphoresEXT(1, &m_semaphores.glComplete);
-
-    // Create semaphores
-#ifdef WIN32
-    const auto handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_WIN32_BIT;
-#else
-    const auto handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
-#endif
-
-    VkExportSemaphoreCreateInfo esci{.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO, .handleTypes = handleType};
-    VkSemaphoreCreateInfo sci{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &esci};
-    NVVK_CHECK(vkCreateSemaphore(m_device, &sci, nullptr, &m_semaphores.vkReady));
-    NVVK_CHECK(vkCreateSemaphore(m_device, &sci, nullptr, &m_semaphores.vkComplete));
-
-    // Import semaphores
-#ifdef WIN32
+    if(m_features.bindless)
+    {
+      m_bindless->remove(m_bindlessSlot);
+      m_bindlessSlot = nvvk::BindlessImageTable::kInvalidSlot;
+    }
+    if(m_sparseTexture.isValid())
+    {
+      m_sparseTexture.destroy();
+      m_textureTarget = {};
+    }
+    else
     {
-      HANDLE                           hglReady{};
-      VkSemaphoreGetWin32HandleInfoKHR handleInfo{.sType      = VK_STRUCTURE_TYPE_SEMAPHORE_GET_WIN32_HANDLE_INFO_KHR,
-                                                  .semaphore  = m_semaphores.vkReady,
-                                                  .handleType = handleType};
-      NVVK_CHECK(vkGetSemaphoreWin32HandleKHR(m_device, &handleInfo, &hglReady));
-
-      HANDLE hglComplete{};
-      handleInfo.semaphore = m_semaphores.vkComplete;
-      NVVK_CHECK(vkGetSemaphoreWin32HandleKHR(m_device, &handleInfo, &hglComplete));
-
-      glImportSemaphoreWin32HandleEXT(m_semaphores.glReady, GL_HANDLE_TYPE_OPAQUE_WIN32_EXT, hglReady);
-      glImportSemaphoreWin32HandleEXT(m_semaphores.glComplete, GL_HANDLE_TYPE_OPAQUE_WIN32_EXT, hglComplete);
+      m_textureTarget.destroy(*m_alloc);
     }
-#else
+    if(m_previousTarget.oglId != 0)
     {
-      int                     fdReady{};
-      VkSemaphoreGetFdInfoKHR handleInfo{.sType      = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
-                                         .semaphore  = m_semaphores.vkReady,
-                                         .handleType = handleType};
-      NVVK_CHECK(vkGetSemaphoreFdKHR(m_device, &handleInfo, &fdReady));
-
-      int fdComplete{};
-      handleInfo.semaphore = m_semaphores.vkComplete;
-      NVVK_CHECK(vkGetSemaphoreFdKHR(m_device, &handleInfo, &fdComplete));
-
-      glImportSemaphoreFdEXT(m_semaphores.glReady, GL_HANDLE_TYPE_OPAQUE_FD_EXT, fdReady);
-      glImportSemaphoreFdEXT(m_semaphores.glComplete, GL_HANDLE_TYPE_OPAQUE_FD_EXT, fdComplete);
+      m_previousTarget.destroy(*m_alloc);
+      m_previousTarget = {};
     }
-#endif
   }
 
+  // Switch between a regular and a sparse-resident image (nullptr); takes effect on the next update()
+  void setSparse(const nvvk::SparseInteropSupport* sparse) { m_sparse = (sparse && sparse->supported) ? sparse : nullptr; }
+
+  // Only the visible pixels are computed, and for sparse images only their pages are resident
+  void setVisibleRegion(const VkRect2D& region) { m_visibleRegion = region; }
+
+  void createSemaphores()
+  {
+    m_semaphores.create(m_device);
+
+    // Internal to Vulkan, orders the sparse page bindings before the compute work
+    VkSemaphoreCreateInfo sparseSci{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    NVVK_CHECK(vkCreateSemaphore(m_device, &sparseSci, nullptr, &m_sparseBound));
+  }
+
+  // With push descriptors, the image is written in the command buffer: there is no pool, no set
+  // allocation and no vkUpdateDescriptorSets, only the set layout.
   void createDescriptors()
   {
+    // The shared table has the layout and the set
+    if(m_features.bindless)
+      return;
+
+    // Create compute pipeline separately from graphics pipelines even if they use the same queue
+    std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{
+        // Binding 0 : Sampled image (write)
+        {.binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+    };
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{
+        .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .flags        = m_features.pushDescriptor ? VkDescriptorSetLayoutCreateFlags(VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) : 0,
+        .bindingCount = uint32_t(setLayoutBindings.size()),
+        .pBindings    = setLayoutBindings.data()};
+    NVVK_CHECK(vkCreateDescriptorSetLayout(m_device, &descriptorSetLayoutInfo, nullptr, &m_descriptorSetLayout));
+
+    if(m_features.pushDescriptor)
+      return;
+
     std::vector<VkDescriptorPoolSize> poolSizes{
         // Compute pipelines uses storage images for writing
         {.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1},
@@ -183,16 +405,6 @@ public:
                                                   .pPoolSizes    = poolSizes.data()};
     NVVK_CHECK(vkCreateDescriptorPool(m_device, &descriptorPoolInfo, nullptr, &m_descriptorPool));
 
-    // Create compute pipeline separately from graphics pipelines even if they use the same queue
-    std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{
-        // Binding 0 : Sampled image (write)
-        {.binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
-    };
-    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-                                                            .bindingCount = uint32_t(setLayoutBindings.size()),
-                                                            .pBindings    = setLayoutBindings.data()};
-    NVVK_CHECK(vkCreateDescriptorSetLayout(m_device, &descriptorSetLayoutInfo, nullptr, &m_descriptorSetLayout));
-
     VkDescriptorSetAllocateInfo allocInfo{.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
                                           .descriptorPool     = m_descriptorPool,
                                           .descriptorSetCount = 1,
@@ -202,6 +414,17 @@ public:
 
   void updateDescriptors()
   {
+    if(m_features.bindless)
+    {
+      m_bindlessSlot = m_bindless->add(m_textureTarget.texVk.descriptor.imageView);
+      if(m_bindlessSlot == nvvk::BindlessImageTable::kInvalidSlot)
+        LOGE("Bindless image table full (%u images), the image is not computed\n", m_bindless->capacity());
+      return;
+    }
+    // Push descriptors are written when recording, see bindDescriptors()
+    if(m_features.pushDescriptor)
+      return;
+
     VkDescriptorImageInfo computeTexDescriptor{.imageView   = m_textureTarget.texVk.descriptor.imageView,
                                                .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
 
@@ -217,23 +440,48 @@ public:
     vkUpdateDescriptorSets(m_device, 1, &computeWriteDescriptorSet, 0, nullptr);
   }
 
+  void bindDescriptors(VkCommandBuffer cmd)
+  {
+    if(m_features.bindless)
+    {
+      m_bindless->bind(cmd);
+      return;
+    }
+    if(!m_features.pushDescriptor)
+    {
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+      return;
+    }
+
+    VkDescriptorImageInfo computeTexDescriptor{.imageView   = m_textureTarget.texVk.descriptor.imageView,
+                                               .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+
+    // Binding 0 : Sampled image (write), no dstSet
+    VkWriteDescriptorSet computeWriteDescriptorSet{
+        .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstBinding      = 0,
+        .descriptorCount = 1,
+        .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .pImageInfo      = &computeTexDescriptor,
+    };
+    vkCmdPushDescriptorSetKHR(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &computeWriteDescriptorSet);
+  }
+
   void createPipelines()
   {
     // Create compute shader pipelines
-    VkPushConstantRange        pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = 1 * sizeof(float)};
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(ComputePushConstants)};
     VkPipelineLayoutCreateInfo layoutInfo{.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
                                           .setLayoutCount         = 1,
                                           .pSetLayouts            = &m_descriptorSetLayout,
                                           .pushConstantRangeCount = 1,
                                           .pPushConstantRanges    = &pushConstants};
-    NVVK_CHECK(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_pipelineLayout));
+    if(m_features.bindless)
+      m_pipelineLayout = m_bindless->pipelineLayout();
+    else
+      NVVK_CHECK(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_pipelineLayout));
 
-    auto                        code = nvh::loadFile("shaders/shader.comp.spv", true, defaultSearchPaths);
-    VkComputePipelineCreateInfo computePipelineInfo{.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-                                                    .stage = nvvk::createShaderStageInfo(m_device, code, VK_SHADER_STAGE_COMPUTE_BIT),
-                                                    .layout = m_pipelineLayout};
-    NVVK_CHECK(vkCreateComputePipelines(m_device, m_pipelineCache, 1, &computePipelineInfo, nullptr, &m_pipeline));
-    vkDestroyShaderModule(m_device, computePipelineInfo.stage.module, nullptr);
+    createComputePipeline(false);
 
     VkCommandBufferAllocateInfo commandBufferInfo{.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
                                                   .commandPool        = m_commandPool,
@@ -242,28 +490,474 @@ public:
     NVVK_CHECK(vkAllocateCommandBuffers(m_device, &commandBufferInfo, &m_commandBuffer));
   }
 
-  void buildCommandBuffers()
+  void createComputePipeline(bool fromDisk)
+  {
+    if(m_features.shaderObject)
+    {
+      createComputeShader(fromDisk);
+      return;
+    }
+
+    VkPipelineShaderStageCreateInfo stage{.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                          .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                          .module = createShaderModule(m_device, m_variant->shader, fromDisk),
+                                          .pName  = "main"};
+    VkComputePipelineCreateInfo computePipelineInfo{.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                                    .stage  = stage,
+                                                    .layout = m_pipelineLayout};
+    m_pipeline = m_pipelineCache->createCompute(computePipelineInfo, m_variant->shader.filename);
+    vkDestroyShaderModule(m_device, stage.module, nullptr);
+  }
+
+  // With shader objects, switching kernels creates no pipeline, and the binary comes from the cache
+  // when the variant was used before
+  void createComputeShader(bool fromDisk)
+  {
+    std::string         fileCode;
+    const SpirvShader   spirv = loadSpirv(m_variant->shader, fromDisk, fileCode);
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(ComputePushConstants)};
+    const VkDescriptorSetLayout setLayout = m_features.bindless ? m_bindless->setLayout() : m_descriptorSetLayout;
+    m_shader = m_shaderCache->createCompute(m_variant->shader.filename, spirv.code, spirv.size, 1, &setLayout,
+                                            pushConstants, !fromDisk);
+  }
+
+  void destroyComputePipeline()
   {
-    static auto tStart = std::chrono::high_resolution_clock::now();
-    auto        tEnd   = std::chrono::high_resolution_clock::now();
-    auto        tDiff  = std::chrono::duration<float>(tEnd - tStart).count();
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    m_pipeline = VK_NULL_HANDLE;
+    // The entry point only exists with the extension
+    if(m_shader != VK_NULL_HANDLE)
+      vkDestroyShaderEXT(m_device, m_shader, nullptr);
+    m_shader = VK_NULL_HANDLE;
+  }
+
+  // Hot-reload: recreate the pipeline from the .spv file on disk instead of the embedded code
+  void reloadShaders()
+  {
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    destroyComputePipeline();
+    createComputePipeline(true);
+    if(m_pingPongPipeline != VK_NULL_HANDLE)
+    {
+      vkDestroyPipeline(m_device, m_pingPongPipeline, nullptr);
+      createPingPongPipeline(true);
+    }
+  }
 
+  // Blur of the image after the kernel, see BlurPass, or FftConvolutionPass in eFft mode. A radius
+  // of 0 disables it. In eFft mode, images too large for the radius, see FftConvolutionPass::fits(),
+  // are not blurred, and devices without the shared memory of the FFT use the separable blur.
+  void setBlur(BlurSettings settings)
+  {
+    if(settings.mode == BlurSettings::eFft && !FftConvolutionPass::isSupported(m_physicalDevice))
+      settings.mode = BlurSettings::eSeparable;
+    m_blurSettings = settings;
+    if(settings.radius == 0)
+      return;
+    const VkExtent2D extent = m_textureTarget.imgSize;
+    if(settings.mode == BlurSettings::eFft)
+    {
+      const bool resize = extent.width != 0 && FftConvolutionPass::fits(m_physicalDevice, extent, settings.radius)
+                          && !m_fft.hasSize(extent, settings.radius);
+      if(m_fft.isValid() && !resize)
+        return;
+      NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+      if(!m_fft.isValid())
+        m_fft.init(m_device, m_physicalDevice, *m_pipelineCache, *m_alloc, m_queueIdxCompute);
+      if(resize)
+        m_fft.resize(*m_alloc, extent, settings.radius);
+      return;
+    }
+    if(m_blur.isValid())
+      return;
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    m_blur.init(m_device, m_physicalDevice, *m_pipelineCache, m_queueIdxCompute);
+    if(extent.width != 0)
+      m_blur.resize(*m_alloc, extent);
+  }
+
+  // GPU time of the last blur, negative if there is none
+  double blurGpuMs() const
+  {
+    if(m_blurSettings.mode == BlurSettings::eFft)
+      return m_fft.isValid() ? m_fft.lastGpuMs() : -1.0;
+    return m_blur.isValid() ? m_blur.lastGpuMs() : -1.0;
+  }
+
+  void recordBlur(VkCommandBuffer cmd)
+  {
+    if(m_blurSettings.radius == 0)
+      return;
+    if(m_blurSettings.mode == BlurSettings::eFft)
+    {
+      if(m_fft.isValid() && FftConvolutionPass::fits(m_physicalDevice, m_textureTarget.imgSize, m_blurSettings.radius))
+        m_fft.record(cmd, m_textureTarget.texVk.descriptor.imageView, m_blurSettings);
+    }
+    else if(m_blur.isValid())
+    {
+      m_blur.record(cmd, m_textureTarget.texVk.descriptor.imageView, m_blurSettings);
+    }
+  }
+
+  // HDR: the kernel writes colors up to KernelParams::hdrIntensity into an RGBA16F image, and the
+  // tone mapping brings them back to the display range, see setToneMapping(). The blur, ping-pong
+  // and sparse images only handle RGBA8. The variant of shader.comp is reset to the best one.
+  void setHdr(bool hdr)
+  {
+    assert(!hdr || (m_iterations == 0 && !m_sparse && m_blurSettings.radius == 0));
+    if(hdr == m_hdr)
+      return;
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    m_hdr = hdr;
+    destroyComputePipeline();
+    m_variant = &selectShaderVariant(m_physicalDevice, format(), m_features.bindless);
+    createComputePipeline(false);
+    if(m_textureTarget.imgSize.width != 0)
+      update(m_textureTarget.imgSize);
+  }
+
+  bool     isHdr() const { return m_hdr; }
+  VkFormat format() const { return m_hdr ? kHdrTextureFormat : kTextureFormat; }
+
+  // Where and how HDR images are tone mapped; LDR images are not
+  void setToneMapping(const ToneMapSettings& settings)
+  {
+    m_toneMapSettings = settings;
+    if(settings.location != ToneMapSettings::eCompute || m_toneMap.isValid())
+      return;
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    m_toneMap.init(m_device, *m_pipelineCache);
+  }
+
+  // Whether the OpenGL present shader must tone map the image
+  bool displayToneMaps() const { return m_hdr && m_toneMapSettings.location == ToneMapSettings::eDisplay; }
+
+  void recordToneMap(VkCommandBuffer cmd)
+  {
+    if(m_hdr && m_toneMapSettings.location == ToneMapSettings::eCompute && m_toneMap.isValid())
+      m_toneMap.record(cmd, m_textureTarget.texVk.descriptor.imageView, m_textureTarget.imgSize, m_toneMapSettings);
+  }
+
+  // GPU time of the last kernel, or of all the ping-pong iterations, with the compute tone mapping;
+  // negative if there is none.
+  double computeGpuMs() const { return m_computeTimer.lastMs(); }
+
+  // Compression of the image into a BC texture, which OpenGL displays instead, see BlockCompressPass.
+  // m_textureTarget then stays with Vulkan. HDR images are not compressed.
+  void setBlockCompression(const BlockCompressSettings& settings)
+  {
+    m_compressSettings = settings;
+    if(settings.format == BlockCompressSettings::eNone)
+      return;
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    if(!m_compress.isValid())
+      m_compress.init(m_device, m_physicalDevice, *m_pipelineCache, m_queueIdxCompute);
+    if(m_textureTarget.imgSize.width != 0 && settings.format != m_compress.format())
+      m_compress.resize(*m_alloc, m_textureTarget.imgSize, settings.format);
+  }
+
+  bool isCompressed() const
+  {
+    return !m_hdr && m_compressSettings.format != BlockCompressSettings::eNone && m_compress.format() == m_compressSettings.format;
+  }
+
+  // OpenGL texture to display: the compressed one, or m_textureTarget
+  GLuint displayTexture() const { return isCompressed() ? m_compress.texture() : m_textureTarget.oglId; }
+
+  // GPU time of the last compression, negative if there is none
+  double compressGpuMs() const { return isCompressed() ? m_compress.lastGpuMs() : -1.0; }
+
+  void recordCompress(VkCommandBuffer cmd)
+  {
+    if(isCompressed())
+      m_compress.record(cmd, m_textureTarget.texVk.descriptor.imageView, m_compressSettings.preset);
+  }
+
+  // Hands m_textureTarget to OpenGL, unless it displays the compressed image
+  void releaseTarget(VkCommandBuffer cmd)
+  {
+    if(!isCompressed())
+      m_targetState.releaseVk(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+  }
+
+  // Signed distance field of the bright parts of the image, which OpenGL outlines, see SdfPass
+  void setSdf(const SdfSettings& settings)
+  {
+    m_sdfSettings = settings;
+    if(!settings.enabled || m_sdf.isValid())
+      return;
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    m_sdf.init(m_device, m_physicalDevice, *m_pipelineCache, m_queueIdxCompute);
+    if(m_textureTarget.imgSize.width != 0)
+      m_sdf.resize(*m_alloc, m_textureTarget.imgSize);
+  }
+
+  // OpenGL texture of the signed distance in pixels, 0 when disabled
+  GLuint sdfTexture() const { return (m_sdfSettings.enabled && m_sdf.isValid()) ? m_sdf.texture() : 0; }
+
+  // Passes of the last distance field and their GPU time, negative if there is none
+  uint32_t sdfPasses() const { return m_sdf.isValid() ? m_sdf.floodPasses() + 2 : 0; }
+  double   sdfGpuMs() const { return sdfTexture() != 0 ? m_sdf.lastGpuMs() : -1.0; }
+
+  void recordSdf(VkCommandBuffer cmd)
+  {
+    if(sdfTexture() != 0)
+      m_sdf.record(cmd, m_textureTarget.texVk.descriptor.imageView, m_sdfSettings);
+  }
+
+  // Automatic exposure of the image, see ExposurePass
+  void setExposure(const ExposureSettings& settings)
+  {
+    m_exposureSettings = settings;
+    if(!settings.enabled || m_exposure.isValid())
+      return;
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    m_exposure.init(m_device, m_physicalDevice, *m_pipelineCache, *m_alloc);
+  }
+
+  // OpenGL buffer holding the ExposureData of the image, 0 when disabled
+  GLuint exposureBuffer() const
+  {
+    return (m_exposureSettings.enabled && m_exposure.isValid()) ? m_exposure.buffer().oglId : 0;
+  }
+
+  void recordExposure(VkCommandBuffer cmd, float time)
+  {
+    if(m_exposureSettings.enabled && m_exposure.isValid())
+    {
+      const VkDescriptorImageInfo source{.imageView = m_textureTarget.texVk.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+      m_exposure.record(cmd, source, m_textureTarget.imgSize, m_exposureSettings, std::max(time - m_lastTime, 0.f));
+    }
+    m_lastTime = time;
+  }
+
+  //--------------------------------------------------------------------------------------------------
+  // Ping-pong: with `iterations` > 0, the kernel is shaders/diffusion.comp instead of shader.comp. It
+  // runs that many times per frame, each iteration reading the image the previous one wrote, with a
+  // barrier in between. The pair is swapped after each iteration, so that m_textureTarget is always
+  // the image written last, which is the only one handed to OpenGL. Not compatible with sparse images.
+  //
+  void setIterations(uint32_t iterations)
+  {
+    const bool pingPong = iterations > 0;
+    if(pingPong == (m_iterations > 0))
+    {
+      m_iterations = iterations;
+      return;
+    }
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    m_iterations = iterations;
+    if(pingPong && m_pingPongPipeline == VK_NULL_HANDLE)
+      createPingPong();
+    // Creates or destroys the second image
+    if(m_textureTarget.imgSize.width != 0)
+      update(m_textureTarget.imgSize);
+  }
+
+  void createPingPong()
+  {
+    m_pingPongDescriptors.init(m_device);
+    m_pingPongDescriptors.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_pingPongDescriptors.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_pingPongDescriptors.initLayout();
+    m_pingPongDescriptors.initPool(2);
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(DiffusionPushConstants)};
+    m_pingPongDescriptors.initPipeLayout(1, &pushConstants);
+    createPingPongPipeline(false);
+  }
+
+  void createPingPongPipeline(bool fromDisk)
+  {
+    VkPipelineShaderStageCreateInfo stage{.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                          .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                          .module = createShaderModule(m_device, kDiffusionShader, fromDisk),
+                                          .pName  = "main"};
+    VkComputePipelineCreateInfo computePipelineInfo{.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                                    .stage  = stage,
+                                                    .layout = m_pingPongDescriptors.getPipeLayout()};
+    m_pingPongPipeline = m_pipelineCache->createCompute(computePipelineInfo, kDiffusionShader.filename);
+    vkDestroyShaderModule(m_device, stage.module, nullptr);
+  }
+
+  void destroyPingPong()
+  {
+    if(m_pingPongPipeline == VK_NULL_HANDLE)
+      return;
+    vkDestroyPipeline(m_device, m_pingPongPipeline, nullptr);
+    m_pingPongPipeline = VK_NULL_HANDLE;
+    m_pingPongDescriptors.deinit();
+  }
+
+  // Set 0 reads m_textureTarget and writes m_previousTarget, set 1 the opposite
+  void updatePingPongDescriptors()
+  {
+    const VkDescriptorImageInfo images[2] = {
+        {.imageView = m_textureTarget.texVk.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL},
+        {.imageView = m_previousTarget.texVk.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL}};
+    const VkWriteDescriptorSet writes[4] = {
+        m_pingPongDescriptors.makeWrite(0, 0, &images[1]), m_pingPongDescriptors.makeWrite(0, 1, &images[0]),
+        m_pingPongDescriptors.makeWrite(1, 0, &images[0]), m_pingPongDescriptors.makeWrite(1, 1, &images[1])};
+    vkUpdateDescriptorSets(m_device, 4, writes, 0, nullptr);
+    m_pingPongParity = 0;
+    m_pingPongReset  = true;
+  }
+
+  // The iterations of the frame; m_textureTarget ends up being the image written last
+  void recordPingPong(VkCommandBuffer cmd, float time)
+  {
+    const VkExtent2D       logicalSize = m_logicalSize.width != 0 ? m_logicalSize : m_textureTarget.imgSize;
+    DiffusionPushConstants pushc{.iTime       = time,
+                                 .rate        = m_params.diffusionRate,
+                                 .decay       = m_params.diffusionDecay,
+                                 .hue         = m_params.hue,
+                                 .center      = {m_params.center[0], m_params.center[1]},
+                                 .tileOffset  = {uint32_t(m_tileOffset.x), uint32_t(m_tileOffset.y)},
+                                 .logicalSize = {logicalSize.width, logicalSize.height}};
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pingPongPipeline);
+    for(uint32_t i = 0; i < m_iterations; i++)
+    {
+      if(i > 0)
+      {
+        // The image written by the previous iteration is read, the one it read is written
+        VkMemoryBarrier barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+      }
+      // Only the first iteration acquires: from OpenGL for the image it displayed, or from UNDEFINED
+      m_targetState.acquireVk(cmd, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+      m_previousState.acquireVk(cmd, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+      const VkDescriptorSet set = m_pingPongDescriptors.getSet(m_pingPongParity);
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pingPongDescriptors.getPipeLayout(), 0, 1, &set, 0, nullptr);
+      pushc.reset = m_pingPongReset ? 1 : 0;
+      vkCmdPushConstants(cmd, m_pingPongDescriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+      // Every pixel, the next iterations read the whole image
+      const VkExtent2D extent = m_textureTarget.imgSize;
+      vkCmdDispatch(cmd, (extent.width + kDiffusionGroupSize - 1) / kDiffusionGroupSize,
+                    (extent.height + kDiffusionGroupSize - 1) / kDiffusionGroupSize, 1);
+
+      std::swap(m_textureTarget, m_previousTarget);
+      std::swap(m_targetState, m_previousState);
+      m_pingPongParity ^= 1;
+      m_pingPongReset = false;
+    }
+  }
+
+  // Switch to another variant of shader.comp, which must be supported and match the image format
+  // and the bindless mode
+  void setVariant(const ComputeShaderVariant& variant)
+  {
+    if(&variant == m_variant)
+      return;
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    destroyComputePipeline();
+    m_variant = &variant;
+    createComputePipeline(false);
+  }
+
+  // Adds the interop resources of the next submission to the frame's registry, returns their batch
+  nvvk::InteropBatch& registerInterop(nvvk::InteropRegistry& registry)
+  {
+    nvvk::InteropBatch& batch = registry.batch(m_semaphores.glReady, m_semaphores.glComplete);
+    // The kernel writes the image in GENERAL, which OpenGL can sample too: neither API changes the layout
+    batch.addTexture(m_targetState, VK_IMAGE_LAYOUT_GENERAL);
+    // Only part of the semaphore operations when OpenGL has it, which is never after the first frame
+    if(m_iterations > 0)
+      batch.addTexture(m_previousState, VK_IMAGE_LAYOUT_GENERAL);
+    if(exposureBuffer() != 0)
+      batch.addBuffer(exposureBuffer());
+    // Written by a copy, in TRANSFER_DST, and OpenGL samples it in that layout
+    if(isCompressed())
+      batch.addTexture(m_compress.state(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    if(sdfTexture() != 0)
+      batch.addTexture(m_sdf.state(), VK_IMAGE_LAYOUT_GENERAL);
+    return batch;
+  }
+
+  // `time` is the animation time in seconds
+  void buildCommandBuffers(float time)
+  {
     NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
     NVVK_CHECK(vkResetFences(m_device, 1, &m_fence));
 
+    // The previous submission is done: pages can be evicted safely. Only resident pages are written.
+    VkRect2D region = clipRegion(m_visibleRegion);
+    if(m_sparseTexture.isValid())
+    {
+      m_sparseBindPending = m_sparseTexture.setResidentRegion(m_queue, region, m_semaphores.vkReady, m_sparseBound);
+      region              = m_sparseTexture.residentRegion();
+    }
+
     VkCommandBufferBeginInfo beginInfo{.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
                                        .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT};
     NVVK_CHECK(vkBeginCommandBuffer(m_commandBuffer, &beginInfo));
-    vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
-    vkCmdBindDescriptorSets(m_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
-    vkCmdPushConstants(m_commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(float), &tDiff);
-
-    vkCmdDispatch(m_commandBuffer, (m_textureTarget.imgSize.width + 15) / 16, (m_textureTarget.imgSize.height + 15) / 16, 1);
+    m_computeTimer.begin(m_commandBuffer);
+    if(m_iterations > 0)
+      recordPingPong(m_commandBuffer, time);
+    else
+      recordKernel(m_commandBuffer, time, region);
+    recordToneMap(m_commandBuffer);
+    m_computeTimer.end(m_commandBuffer);
+    recordBlur(m_commandBuffer);
+    recordSdf(m_commandBuffer);
+    recordExposure(m_commandBuffer, time);
+    recordCompress(m_commandBuffer);
+    releaseTarget(m_commandBuffer);
     NVVK_CHECK(vkEndCommandBuffer(m_commandBuffer));
   }
 
+  // shader.comp over `region` of m_textureTarget
+  void recordKernel(VkCommandBuffer cmd, float time, const VkRect2D& region)
+  {
+    m_targetState.acquireVk(cmd, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    if(m_features.shaderObject)
+    {
+      const VkShaderStageFlagBits stage = VK_SHADER_STAGE_COMPUTE_BIT;
+      vkCmdBindShadersEXT(cmd, 1, &stage, &m_shader);
+    }
+    else
+    {
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    }
+    bindDescriptors(cmd);
+    const VkExtent2D     logicalSize = m_logicalSize.width != 0 ? m_logicalSize : m_textureTarget.imgSize;
+    ComputePushConstants pushc{.iTime          = time,
+                               .speed          = m_params.speed,
+                               .scale          = m_params.scale,
+                               .hue            = m_params.hue,
+                               .center         = {m_params.center[0], m_params.center[1]},
+                               .tileOffset     = {uint32_t(m_tileOffset.x), uint32_t(m_tileOffset.y)},
+                               .logicalSize    = {logicalSize.width, logicalSize.height},
+                               .dispatchOffset = {uint32_t(region.offset.x), uint32_t(region.offset.y)},
+                               .imageIndex     = m_bindlessSlot,
+                               .intensity      = m_hdr ? m_params.hdrIntensity : 1.0f};
+    vkCmdPushConstants(cmd, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+
+    // An empty command buffer is still submitted, it carries the semaphores
+    const bool hasImage = !m_features.bindless || m_bindlessSlot != nvvk::BindlessImageTable::kInvalidSlot;
+    if(hasImage && region.extent.width > 0 && region.extent.height > 0)
+    {
+      const uint32_t groupSize = m_variant->workgroupSize;
+      vkCmdDispatch(cmd, (region.extent.width + groupSize - 1) / groupSize,
+                    (region.extent.height + groupSize - 1) / groupSize, 1);
+    }
+  }
+
+  VkRect2D clipRegion(const VkRect2D& region) const
+  {
+    const VkExtent2D size = m_textureTarget.imgSize;
+    const int32_t    x0   = std::clamp(region.offset.x, 0, int32_t(size.width));
+    const int32_t    y0   = std::clamp(region.offset.y, 0, int32_t(size.height));
+    const int32_t    x1   = std::clamp(int32_t(region.offset.x + int64_t(region.extent.width)), x0, int32_t(size.width));
+    const int32_t    y1   = std::clamp(int32_t(region.offset.y + int64_t(region.extent.height)), y0, int32_t(size.height));
+    return {{x0, y0}, {uint32_t(x1 - x0), uint32_t(y1 - y0)}};
+  }
+
 
-  nvvk::Texture2DVkGL prepareTextureTarget(VkImageLayout targetLayout, const VkExtent2D& extent, VkFormat format)
+  // The image is left UNDEFINED, see m_targetState
+  nvvk::Texture2DVkGL prepareTextureTarget(const VkExtent2D& extent, VkFormat format)
   {
     // Get device properties for the requested texture format
     VkFormatProperties formatProperties{};
@@ -282,16 +976,18 @@ public:
                                       // VkImage will be sampled in the fragment shader and used as storage target in the compute shader
                                       .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT};
 
-    // Create the texture from the image and add a default sampler
-    nvvk::Image           image  = m_alloc->createImage(imageCreateInfo);
-    VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
-    nvvk::Texture2DVkGL   texture;
-    texture.texVk = m_alloc->createTexture(image, ivInfo, {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO}), texture.imgSize = extent;
-
+    nvvk::Texture2DVkGL texture;
+    if(m_sparse)
+    {
+      // Sparse-resident: no memory yet, pages get bound in buildCommandBuffers()
+      m_sparseTexture.create(m_device, m_physicalDevice, *m_sparse, extent, format, glTextureFormat(format), texture);
+    }
+    else
     {
-      // Convert the image to the desired layout
-      nvvk::ScopeCommandBuffer cmdBuf(m_device, m_queueIdxGraphic);
-      nvvk::cmdBarrierImageLayout(cmdBuf, texture.texVk.image, VK_IMAGE_LAYOUT_UNDEFINED, targetLayout);
+      // Create the texture from the image and add a default sampler
+      nvvk::Image           image  = m_alloc->createImage(imageCreateInfo);
+      VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
+      texture.texVk = m_alloc->createTexture(image, ivInfo, {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO}), texture.imgSize = extent;
     }
 
     return texture;
@@ -299,17 +995,20 @@ public:
 
   void submit()
   {
-    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    // The sparse bindings already waited on vkReady, and are done when m_sparseBound is signaled
+    const VkPipelineStageFlags waitStage     = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    const VkSemaphore          waitSemaphore = m_sparseBindPending ? m_sparseBound : m_semaphores.vkReady;
     // Submit compute commands
     VkSubmitInfo computeSubmitInfo{.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
                                    .waitSemaphoreCount   = 1,
-                                   .pWaitSemaphores      = &m_semaphores.vkReady,
+                                   .pWaitSemaphores      = &waitSemaphore,
                                    .pWaitDstStageMask    = &waitStage,
                                    .commandBufferCount   = 1,
                                    .pCommandBuffers      = &m_commandBuffer,
                                    .signalSemaphoreCount = 1,
                                    .pSignalSemaphores    = &m_semaphores.vkComplete};
+    // No wait on the queue: OpenGL waits on the GPU for vkComplete, and the fence guards the
+    // reuse of the command buffer. This lets several producers run concurrently.
     NVVK_CHECK(vkQueueSubmit(m_queue, 1, &computeSubmitInfo, m_fence));
-    NVVK_CHECK(vkQueueWaitIdle(m_queue));
   }
 };
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "gl_vk.hpp"
+#include "pipeline_cache.hpp"
+#include "spirv.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "exposure_comp_spv.h"
+#include "histogram_comp_shared_spv.h"
+#include "histogram_comp_subgroup_spv.h"
+
+struct ExposureSettings
+{
+  bool  enabled{false};
+  float key{0.5f};              // Luminance the adapted average is mapped to
+  float adaptationSpeed{2.0f};  // Per second
+  float minLog2{-8.0f};         // Luminance range of the histogram, in log2
+  float maxLog2{4.0f};
+
+  bool operator==(const ExposureSettings&) const = default;
+};
+
+// Must match the push_constant blocks of shaders/histogram.comp and shaders/exposure.comp
+struct ExposurePushConstants
+{
+  float minLog2;
+  float rangeLog2;
+  float key;
+  float adaptation;
+};
+
+// Must match the Exposure block of shaders/exposure.comp and of the OpenGL present shader
+struct ExposureData
+{
+  float exposure;
+  float averageLuminance;
+  float targetLuminance;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Automatic exposure of an interop image, computed on the GPU and read by OpenGL without readback:
+// - shaders/histogram.comp builds a luminance histogram. Bins are privatized in shared memory per
+//   workgroup, and with subgroup ballot, the lanes falling in the same bin make a single atomic.
+// - shaders/exposure.comp, a single workgroup, reduces it to an average log luminance, adapts
+//   toward it over time, and writes the exposure into a small interop buffer
+// OpenGL binds that buffer as a uniform block when drawing the image.
+//
+class ExposurePass
+{
+public:
+  static constexpr uint32_t kBinCount = 256;  // BIN_COUNT of the shaders
+
+  // Subgroup ballot in compute shaders, for the histogram
+  static bool isSubgroupSupported(VkPhysicalDevice physicalDevice)
+  {
+    VkPhysicalDeviceSubgroupProperties subgroup{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &subgroup};
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    return (subgroup.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) && (subgroup.supportedOperations & VK_SUBGROUP_FEATURE_BALLOT_BIT);
+  }
+
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, const ComputePipelineCache& pipelineCache, nvvk::ResourceAllocator& alloc)
+  {
+    m_device = device;
+
+    m_histogram = alloc.createBuffer(kBinCount * sizeof(uint32_t),
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_exposure.bufVk = alloc.createBuffer(sizeof(ExposureData),
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+                                              | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createBufferGL(alloc, m_exposure);
+    m_buffersReady = false;
+
+    m_descriptors.init(device);
+    m_descriptors.addBinding(0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.initLayout();
+    m_descriptors.initPool(1);
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(ExposurePushConstants)};
+    m_descriptors.initPipeLayout(1, &pushConstants);
+
+    const VkDescriptorBufferInfo histogram{m_histogram.buffer, 0, VK_WHOLE_SIZE};
+    const VkDescriptorBufferInfo exposure{m_exposure.bufVk.buffer, 0, VK_WHOLE_SIZE};
+    const VkWriteDescriptorSet   writes[2] = {m_descriptors.makeWrite(0, 1, &histogram), m_descriptors.makeWrite(0, 2, &exposure)};
+    vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    m_sourceView = VK_NULL_HANDLE;
+
+    m_subgroup = isSubgroupSupported(physicalDevice);
+    m_histogramPipeline =
+        createPipeline(pipelineCache, m_subgroup ? makeSpirvShader("shaders/histogram_comp_subgroup.spv", histogram_comp_subgroup_spv) :
+                                                   makeSpirvShader("shaders/histogram_comp_shared.spv", histogram_comp_shared_spv));
+    m_exposurePipeline = createPipeline(pipelineCache, makeSpirvShader("shaders/exposure_comp.spv", exposure_comp_spv));
+  }
+
+  void deinit(nvvk::ResourceAllocator& alloc)
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+    alloc.destroy(m_histogram);
+    m_exposure.destroy(alloc);
+    m_exposure = {};
+    vkDestroyPipeline(m_device, m_histogramPipeline, nullptr);
+    vkDestroyPipeline(m_device, m_exposurePipeline, nullptr);
+    m_descriptors.deinit();
+    m_device = VK_NULL_HANDLE;
+  }
+
+  bool isValid() const { return m_device != VK_NULL_HANDLE; }
+  bool usesSubgroups() const { return m_subgroup; }
+
+  // The source image was recreated: a new view can have the handle of the destroyed one
+  void invalidate() { m_sourceView = VK_NULL_HANDLE; }
+
+  // Holds an ExposureData, to bind as a uniform block in OpenGL
+  const nvvk::BufferVkGL& buffer() const { return m_exposure; }
+
+  // Records the exposure of `source`, a sampled image in GENERAL written by compute shaders before.
+  // `deltaTime` is the time since the previous frame, in seconds.
+  void record(VkCommandBuffer cmd, const VkDescriptorImageInfo& source, VkExtent2D extent, const ExposureSettings& settings, float deltaTime)
+  {
+    if(source.imageView != m_sourceView)
+    {
+      const VkWriteDescriptorSet write = m_descriptors.makeWrite(0, 0, &source);
+      vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+      m_sourceView = source.imageView;
+    }
+
+    VkMemoryBarrier barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    if(!m_buffersReady)
+    {
+      // Empty histogram, and an exposure of 1 to adapt from
+      vkCmdFillBuffer(cmd, m_histogram.buffer, 0, VK_WHOLE_SIZE, 0);
+      vkCmdFillBuffer(cmd, m_exposure.bufVk.buffer, 0, VK_WHOLE_SIZE, 0x3f800000);  // 1.0f
+      VkMemoryBarrier fillBarrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                  .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                                  .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+      vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &fillBarrier,
+                           0, nullptr, 0, nullptr);
+      m_buffersReady = true;
+    }
+    // The image is complete
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                         0, nullptr, 0, nullptr);
+
+    const VkDescriptorSet       set = m_descriptors.getSet(0);
+    const ExposurePushConstants pushc{.minLog2    = settings.minLog2,
+                                      .rangeLog2  = std::max(settings.maxLog2 - settings.minLog2, 1e-3f),
+                                      .key        = settings.key,
+                                      .adaptation = 1.0f - std::exp(-deltaTime * settings.adaptationSpeed)};
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_descriptors.getPipeLayout(), 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(cmd, m_descriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_histogramPipeline);
+    vkCmdDispatch(cmd, (extent.width + 15) / 16, (extent.height + 15) / 16, 1);
+
+    // The histogram is complete
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                         0, nullptr, 0, nullptr);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_exposurePipeline);
+    vkCmdDispatch(cmd, 1, 1, 1);
+  }
+
+private:
+  VkPipeline createPipeline(const ComputePipelineCache& pipelineCache, const SpirvShader& shader)
+  {
+    VkPipelineShaderStageCreateInfo stage{.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                          .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                          .module = createShaderModule(m_device, shader),
+                                          .pName  = "main"};
+    VkComputePipelineCreateInfo pipelineInfo{.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                             .stage  = stage,
+                                             .layout = m_descriptors.getPipeLayout()};
+    VkPipeline pipeline = pipelineCache.createCompute(pipelineInfo, shader.filename);
+    vkDestroyShaderModule(m_device, stage.module, nullptr);
+    return pipeline;
+  }
+
+  VkDevice                     m_device{};
+  nvvk::DescriptorSetContainer m_descriptors;
+  VkPipeline                   m_histogramPipeline{};
+  VkPipeline                   m_exposurePipeline{};
+  nvvk::Buffer                 m_histogram;            // kBinCount counters, Vulkan only
+  nvvk::BufferVkGL             m_exposure;             // ExposureData, read by OpenGL
+  bool                         m_buffersReady{false};  // Initialized by the first record()
+  bool                         m_subgroup{false};      // Histogram with subgroup ballot
+  VkImageView                  m_sourceView{};         // Of the descriptor set
+};
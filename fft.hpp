@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "blur.hpp"
+#include "gpu_timer.hpp"
+#include "pipeline_cache.hpp"
+#include "spirv.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
+#include "nvvk/images_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "fft_comp_spv.h"
+
+// Must match the push_constant block of shaders/fft.comp
+struct FftPushConstants
+{
+  uint32_t pass;
+  uint32_t radius;
+  uint32_t log2Width;  // Of the padded spectrum
+  uint32_t log2Height;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Blur of an RGBA8 storage image in place by convolution in the frequency domain, for radii beyond
+// what BlurPass handles. The cost does not depend on the radius, only on the padded size.
+// The image, extended by `radius` clamped pixels on each side, is padded to powers of two so that
+// the circular convolution does not wrap. R + iG and B + iA are two complex signals, an RGBA32F
+// spectrum holds both. Three passes, one workgroup per line, each line transformed in shared memory
+// by a Stockham radix-4 FFT (with a radix-2 stage for odd powers of two):
+// - rows: forward FFT of each padded row
+// - columns: forward FFT, multiplication by the kernel spectrum, inverse FFT
+// - inverse rows: inverse FFT of the rows of the image, written back to the target
+// The kernel is separable and symmetric, its spectrum is the product of two real 1D spectra,
+// computed on the CPU when the radius changes and uploaded with the command buffer.
+//
+class FftConvolutionPass
+{
+public:
+  static constexpr uint32_t kMaxSize       = 2048;  // MAX_SIZE of shaders/fft.comp, per side of the spectrum
+  static constexpr uint32_t kMaxRadius     = 512;
+  static constexpr uint32_t kSharedMemSize = kMaxSize * 4 * sizeof(float);  // s_data of shaders/fft.comp
+
+  // A line of the spectrum in shared memory is 32 KB, twice what Vulkan guarantees
+  static bool isSupported(VkPhysicalDevice physicalDevice)
+  {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    return properties.limits.maxComputeSharedMemorySize >= kSharedMemSize;
+  }
+
+  // Side of the spectrum for a side of the image
+  static uint32_t paddedSize(uint32_t size, uint32_t radius)
+  {
+    uint32_t padded = 1;
+    while(padded < size + 2 * radius)
+      padded <<= 1;
+    return padded;
+  }
+
+  // Whether the device runs the pass, and the padded image fits the shared memory of a workgroup
+  static bool fits(VkPhysicalDevice physicalDevice, VkExtent2D extent, uint32_t radius)
+  {
+    return isSupported(physicalDevice) && paddedSize(extent.width, radius) <= kMaxSize
+           && paddedSize(extent.height, radius) <= kMaxSize;
+  }
+
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, const ComputePipelineCache& pipelineCache, nvvk::ResourceAllocator& alloc, uint32_t queueFamily)
+  {
+    assert(isSupported(physicalDevice));
+    m_device = device;
+    m_timer.init(device, physicalDevice, queueFamily);
+
+    // Spectrum of the kernel along rows, then along columns
+    m_kernel = alloc.createBuffer(2 * kMaxSize * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    m_descriptors.init(device);
+    m_descriptors.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.initLayout();
+    m_descriptors.initPool(1);
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(FftPushConstants)};
+    m_descriptors.initPipeLayout(1, &pushConstants);
+
+    const VkDescriptorBufferInfo kernel{m_kernel.buffer, 0, VK_WHOLE_SIZE};
+    const VkWriteDescriptorSet   write = m_descriptors.makeWrite(0, 2, &kernel);
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+    const SpirvShader               shader = makeSpirvShader("shaders/fft_comp.spv", fft_comp_spv);
+    VkPipelineShaderStageCreateInfo stage{.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                          .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                          .module = createShaderModule(device, shader),
+                                          .pName  = "main"};
+    VkComputePipelineCreateInfo pipelineInfo{.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                             .stage  = stage,
+                                             .layout = m_descriptors.getPipeLayout()};
+    m_pipeline = pipelineCache.createCompute(pipelineInfo, shader.filename);
+    vkDestroyShaderModule(device, stage.module, nullptr);
+  }
+
+  void deinit(nvvk::ResourceAllocator& alloc)
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+    destroyImages(alloc);
+    alloc.destroy(m_kernel);
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    m_descriptors.deinit();
+    m_timer.deinit();
+    m_device = VK_NULL_HANDLE;
+  }
+
+  bool isValid() const { return m_device != VK_NULL_HANDLE; }
+
+  // The spectrum for images of `extent` blurred by `radius`, which must fit(). Only recreated when
+  // the padded size changes, the GPU must not use it anymore then.
+  void resize(nvvk::ResourceAllocator& alloc, VkExtent2D extent, uint32_t radius)
+  {
+    // The images to blur were recreated too, a new view can have the handle of a destroyed one
+    m_extent                = extent;
+    m_targetView            = VK_NULL_HANDLE;
+    const VkExtent2D padded = {paddedSize(extent.width, radius), paddedSize(extent.height, radius)};
+    if(padded.width == m_padded.width && padded.height == m_padded.height)
+      return;
+
+    destroyImages(alloc);
+    VkImageCreateInfo imageInfo{.sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                                .imageType   = VK_IMAGE_TYPE_2D,
+                                .format      = VK_FORMAT_R32G32B32A32_SFLOAT,
+                                .extent      = {padded.width, padded.height, 1},
+                                .mipLevels   = 1,
+                                .arrayLayers = 1,
+                                .samples     = VK_SAMPLE_COUNT_1_BIT,
+                                .tiling      = VK_IMAGE_TILING_OPTIMAL,
+                                .usage       = VK_IMAGE_USAGE_STORAGE_BIT};
+    nvvk::Image           image  = alloc.createImage(imageInfo);
+    VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageInfo);
+    m_spectrum                   = alloc.createTexture(image, ivInfo);
+    m_padded                     = padded;
+    m_spectrumReady              = false;
+    m_kernelSettings             = {};  // Depends on the padded size
+
+    const VkDescriptorImageInfo spectrum{.imageView = m_spectrum.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkWriteDescriptorSet  write = m_descriptors.makeWrite(0, 1, &spectrum);
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+  }
+
+  // Whether resize() was called for these
+  bool hasSize(VkExtent2D extent, uint32_t radius) const
+  {
+    return extent.width == m_extent.width && extent.height == m_extent.height
+           && paddedSize(extent.width, radius) == m_padded.width && paddedSize(extent.height, radius) == m_padded.height;
+  }
+
+  void destroyImages(nvvk::ResourceAllocator& alloc)
+  {
+    alloc.destroy(m_spectrum);
+    m_spectrum = {};
+    m_padded   = {0, 0};
+  }
+
+  // Records the blur of `targetView`, in GENERAL and written by compute shaders before. resize()
+  // must have been called with the radius of `settings`.
+  void record(VkCommandBuffer cmd, VkImageView targetView, const BlurSettings& settings)
+  {
+    if(targetView != m_targetView)
+    {
+      const VkDescriptorImageInfo target{.imageView = targetView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+      const VkWriteDescriptorSet  write = m_descriptors.makeWrite(0, 0, &target);
+      vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+      m_targetView = targetView;
+    }
+
+    const BlurSettings kernelSettings{.radius = settings.radius, .gaussian = settings.gaussian};
+    if(!(kernelSettings == m_kernelSettings))
+    {
+      const std::vector<float> spectrum = kernelSpectrum(settings);
+      vkCmdUpdateBuffer(cmd, m_kernel.buffer, 0, spectrum.size() * sizeof(float), spectrum.data());
+      VkMemoryBarrier updateBarrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                                    .dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
+      vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                           &updateBarrier, 0, nullptr, 0, nullptr);
+      m_kernelSettings = kernelSettings;
+    }
+
+    // The kernel's writes are read, and the spectrum gets its layout once
+    VkImageMemoryBarrier initLayout{.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                    .dstAccessMask    = VK_ACCESS_SHADER_WRITE_BIT,
+                                    .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
+                                    .newLayout        = VK_IMAGE_LAYOUT_GENERAL,
+                                    .image            = m_spectrum.image,
+                                    .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+    barrier(cmd, m_spectrumReady ? nullptr : &initLayout);
+    m_spectrumReady = true;
+
+    const VkDescriptorSet set = m_descriptors.getSet(0);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_descriptors.getPipeLayout(), 0, 1, &set, 0, nullptr);
+
+    FftPushConstants pushc{.radius     = settings.radius,
+                           .log2Width  = log2(m_padded.width),
+                           .log2Height = log2(m_padded.height)};
+    // Workgroups: padded rows, padded columns, rows of the image
+    const uint32_t workgroups[3] = {m_padded.height, m_padded.width, m_extent.height};
+    m_timer.begin(cmd);
+    for(uint32_t pass = 0; pass < 3; pass++)
+    {
+      if(pass > 0)
+        barrier(cmd, nullptr);
+      pushc.pass = pass;
+      vkCmdPushConstants(cmd, m_descriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+      vkCmdDispatch(cmd, workgroups[pass], 1, 1);
+    }
+    m_timer.end(cmd);
+  }
+
+  // GPU time of the last convolution measured, negative if there is none
+  double lastGpuMs() const { return m_timer.lastMs(); }
+
+private:
+  static uint32_t log2(uint32_t powerOfTwo)
+  {
+    uint32_t log2 = 0;
+    while((1u << log2) < powerOfTwo)
+      log2++;
+    return log2;
+  }
+
+  // Real spectra of the 1D kernel, the same weights as shaders/blur.comp, for the padded width then
+  // the padded height. Each is normalized by its size, which the inverse FFT does not do.
+  std::vector<float> kernelSpectrum(const BlurSettings& settings) const
+  {
+    const uint32_t     radius = settings.radius;
+    const float        sigma  = std::max(float(radius) * 0.5f, 0.5f);
+    std::vector<float> weights(radius + 1);
+    float              total = 0.f;
+    for(uint32_t i = 0; i <= radius; i++)
+    {
+      weights[i] = settings.gaussian ? std::exp(-float(i * i) / (2.f * sigma * sigma)) : 1.f;
+      total += i == 0 ? weights[i] : 2.f * weights[i];
+    }
+
+    constexpr double   kPi = 3.14159265358979323846;
+    std::vector<float> spectrum;
+    spectrum.reserve(m_padded.width + m_padded.height);
+    for(uint32_t size : {m_padded.width, m_padded.height})
+    {
+      for(uint32_t k = 0; k < size; k++)
+      {
+        // The kernel is symmetric: the sines cancel out
+        double sum = weights[0];
+        for(uint32_t i = 1; i <= radius; i++)
+          sum += 2.0 * weights[i] * std::cos(2.0 * kPi * double((uint64_t(k) * i) % size) / double(size));
+        spectrum.push_back(float(sum / (double(total) * double(size))));
+      }
+    }
+    return spectrum;
+  }
+
+  // Between passes, and from the kernel: the next one reads what the previous wrote, and writes
+  // what it read
+  static void barrier(VkCommandBuffer cmd, const VkImageMemoryBarrier* initLayout)
+  {
+    VkMemoryBarrier barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &barrier, 0, nullptr, initLayout ? 1 : 0, initLayout);
+  }
+
+  VkDevice                     m_device{};
+  nvvk::DescriptorSetContainer m_descriptors;
+  VkPipeline                   m_pipeline{};
+  nvvk::Buffer                 m_kernel;                // Spectra of kernelSpectrum()
+  BlurSettings                 m_kernelSettings;        // Of m_kernel, radius 0 when not uploaded
+  nvvk::Texture                m_spectrum;              // RGBA32F, m_padded
+  VkExtent2D                   m_extent{0, 0};          // Of the images to blur
+  VkExtent2D                   m_padded{0, 0};          // Powers of two
+  bool                         m_spectrumReady{false};  // In GENERAL
+  VkImageView                  m_targetView{};          // Of the descriptor set
+  nvvk::GpuTimer               m_timer;
+};
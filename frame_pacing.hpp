@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <thread>
+
+#include <nvgl/extensions_gl.hpp>
+#include <GLFW/glfw3.h>
+
+//--------------------------------------------------------------------------------------------------
+// Presentation control:
+// - the swap mode: vsync, uncapped, adaptive (late frames tear instead of waiting), or uncapped
+//   with a CPU frame limiter
+// - the number of frames OpenGL may queue ahead of the GPU, bounded with fences, which bounds
+//   the input latency
+//
+class FramePacer
+{
+public:
+  enum SwapMode : int
+  {
+    eVsync,
+    eUncapped,
+    eAdaptive,
+    eLimited,
+  };
+
+  // Must be called with the window's context current
+  void init()
+  {
+    m_adaptiveSupported =
+        glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+    apply();
+  }
+
+  void deinit()
+  {
+    for(GLsync fence : m_frameFences)
+      glDeleteSync(fence);
+    m_frameFences.clear();
+  }
+
+  void setMode(SwapMode mode)
+  {
+    if(mode == eAdaptive && !m_adaptiveSupported)
+      mode = eVsync;
+    m_mode    = mode;
+    m_changed = true;
+  }
+
+  SwapMode mode() const { return m_mode; }
+  bool     adaptiveSupported() const { return m_adaptiveSupported; }
+
+  int  m_maxQueuedFrames{2};  // Frames OpenGL may have in flight, 0 for no limit
+  int  m_limiterFps{120};     // Target of the CPU frame limiter
+  bool m_changed{false};
+
+  // Before rendering: apply a changed swap mode and wait for the frame limiter
+  void beginFrame()
+  {
+    if(m_changed)
+      apply();
+
+    auto now = std::chrono::steady_clock::now();
+    if(m_mode == eLimited && m_limiterFps > 0)
+    {
+      const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / m_limiterFps));
+      // Sleep is coarse: sleep up to a margin before the deadline, then spin
+      const auto margin = std::chrono::milliseconds(2);
+      if(m_nextFrame - now > margin)
+        std::this_thread::sleep_for(m_nextFrame - now - margin);
+      while(std::chrono::steady_clock::now() < m_nextFrame)
+        std::this_thread::yield();
+      now = std::chrono::steady_clock::now();
+      // Do not try to catch up after a long frame
+      m_nextFrame = std::max(m_nextFrame + period, now);
+    }
+    else
+    {
+      m_nextFrame = now;
+    }
+  }
+
+  // After the swap: fence the frame, and wait for the oldest one when too many are queued
+  void endFrame()
+  {
+    if(m_maxQueuedFrames == 0)
+    {
+      deinit();
+      return;
+    }
+    m_frameFences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    while(int(m_frameFences.size()) > m_maxQueuedFrames)
+    {
+      GLsync oldest = m_frameFences.front();
+      m_frameFences.pop_front();
+      glClientWaitSync(oldest, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+      glDeleteSync(oldest);
+    }
+  }
+
+private:
+  void apply()
+  {
+    switch(m_mode)
+    {
+      case eVsync:
+        glfwSwapInterval(1);
+        break;
+      case eAdaptive:
+        glfwSwapInterval(-1);  // EXT_swap_control_tear: negative interval
+        break;
+      case eUncapped:
+      case eLimited:
+        glfwSwapInterval(0);
+        break;
+    }
+    m_changed = false;
+  }
+
+  SwapMode                              m_mode{eVsync};
+  bool                                  m_adaptiveSupported{false};
+  std::deque<GLsync>                    m_frameFences;
+  std::chrono::steady_clock::time_point m_nextFrame{};
+};
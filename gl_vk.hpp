@@ -97,6 +97,39 @@ struct Texture2DVkGL
   }
 };
 
+// #VKGL Extra for Interop: a 3D image, e.g. a volume
+struct Texture3DVkGL
+{
+  nvvk::Texture texVk;
+
+  uint32_t   mipLevels{1};
+  VkExtent3D imgSize{0, 0, 0};
+#ifdef WIN32
+  HANDLE handle{nullptr};  // The Win32 handle
+#else
+  int fd{-1};
+#endif
+  GLuint memoryObject{0};  // OpenGL memory object
+  GLuint oglId{0};         // OpenGL object ID
+
+  void destroy(nvvk::ResourceAllocator& alloc)
+  {
+    alloc.destroy(texVk);
+
+#ifdef WIN32
+    CloseHandle(handle);
+#else
+    if(fd != -1)
+    {
+      close(fd);
+      fd = -1;
+    }
+#endif
+    glDeleteTextures(1, &oglId);
+    glDeleteMemoryObjectsEXT(1, &memoryObject);
+  }
+};
+
 // Get the Vulkan buffer and create the OpenGL equivalent using the memory allocated in Vulkan
 inline void createBufferGL(nvvk::ResourceAllocator& alloc, BufferVkGL& bufGl)
 {
@@ -128,8 +161,79 @@ inline void createBufferGL(nvvk::ResourceAllocator& alloc, BufferVkGL& bufGl)
   glNamedBufferStorageMemEXT(bufGl.oglId, req.size, bufGl.memoryObject, info.offset);
 }
 
-// Get the Vulkan texture and create the OpenGL equivalent using the memory allocated in Vulkan
-inline void createTextureGL(nvvk::ResourceAllocator& alloc, Texture2DVkGL& texGl, int format, int minFilter, int magFilter, int wrap)
+// Semaphores of a Vulkan submission shared with OpenGL: OpenGL signals glReady before the
+// submission, which waits on vkReady, and waits on glComplete, which the submission signals as vkComplete
+struct InteropSemaphores
+{
+  VkSemaphore vkReady{};
+  VkSemaphore vkComplete{};
+  GLuint      glReady{0};
+  GLuint      glComplete{0};
+
+  void create(VkDevice device)
+  {
+    glGenSemaphoresEXT(1, &glReady);
+    glGenSemaphoresEXT(1, &glComplete);
+
+    // Create semaphores
+#ifdef WIN32
+    const auto handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_WIN32_BIT;
+#else
+    const auto handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+#endif
+
+    VkExportSemaphoreCreateInfo esci{.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO, .handleTypes = handleType};
+    VkSemaphoreCreateInfo sci{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &esci};
+    NVVK_CHECK(vkCreateSemaphore(device, &sci, nullptr, &vkReady));
+    NVVK_CHECK(vkCreateSemaphore(device, &sci, nullptr, &vkComplete));
+
+    // Import semaphores
+#ifdef WIN32
+    {
+      HANDLE                           hglReady{};
+      VkSemaphoreGetWin32HandleInfoKHR handleInfo{.sType      = VK_STRUCTURE_TYPE_SEMAPHORE_GET_WIN32_HANDLE_INFO_KHR,
+                                                  .semaphore  = vkReady,
+                                                  .handleType = handleType};
+      NVVK_CHECK(vkGetSemaphoreWin32HandleKHR(device, &handleInfo, &hglReady));
+
+      HANDLE hglComplete{};
+      handleInfo.semaphore = vkComplete;
+      NVVK_CHECK(vkGetSemaphoreWin32HandleKHR(device, &handleInfo, &hglComplete));
+
+      glImportSemaphoreWin32HandleEXT(glReady, GL_HANDLE_TYPE_OPAQUE_WIN32_EXT, hglReady);
+      glImportSemaphoreWin32HandleEXT(glComplete, GL_HANDLE_TYPE_OPAQUE_WIN32_EXT, hglComplete);
+    }
+#else
+    {
+      int                     fdReady{};
+      VkSemaphoreGetFdInfoKHR handleInfo{.sType      = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+                                         .semaphore  = vkReady,
+                                         .handleType = handleType};
+      NVVK_CHECK(vkGetSemaphoreFdKHR(device, &handleInfo, &fdReady));
+
+      int fdComplete{};
+      handleInfo.semaphore = vkComplete;
+      NVVK_CHECK(vkGetSemaphoreFdKHR(device, &handleInfo, &fdComplete));
+
+      glImportSemaphoreFdEXT(glReady, GL_HANDLE_TYPE_OPAQUE_FD_EXT, fdReady);
+      glImportSemaphoreFdEXT(glComplete, GL_HANDLE_TYPE_OPAQUE_FD_EXT, fdComplete);
+    }
+#endif
+  }
+
+  void destroy(VkDevice device)
+  {
+    vkDestroySemaphore(device, vkReady, nullptr);
+    vkDestroySemaphore(device, vkComplete, nullptr);
+    glDeleteSemaphoresEXT(1, &glReady);
+    glDeleteSemaphoresEXT(1, &glComplete);
+  }
+};
+
+// Imports the memory of the Vulkan image of a Texture2DVkGL or Texture3DVkGL in a new OpenGL
+// memory object, and returns the offset of the image in it
+template <typename TextureVkGL>
+inline VkDeviceSize importTextureMemoryGL(nvvk::ResourceAllocator& alloc, TextureVkGL& texGl)
 {
   VkDevice                    device = alloc.getDevice();
   nvvk::MemAllocator::MemInfo info   = alloc.getMemoryAllocator()->getMemoryInfo(texGl.texVk.memHandle);
@@ -156,13 +260,34 @@ inline void createTextureGL(nvvk::ResourceAllocator& alloc, Texture2DVkGL& texGl
   // fd got consumed
   texGl.fd = -1;
 #endif
+  return info.offset;
+}
+
+// Get the Vulkan texture and create the OpenGL equivalent using the memory allocated in Vulkan
+inline void createTextureGL(nvvk::ResourceAllocator& alloc, Texture2DVkGL& texGl, int format, int minFilter, int magFilter, int wrap)
+{
+  const VkDeviceSize offset = importTextureMemoryGL(alloc, texGl);
   glCreateTextures(GL_TEXTURE_2D, 1, &texGl.oglId);
   glTextureStorageMem2DEXT(texGl.oglId, texGl.mipLevels, format, texGl.imgSize.width, texGl.imgSize.height,
-                           texGl.memoryObject, info.offset);
+                           texGl.memoryObject, offset);
+  glTextureParameteri(texGl.oglId, GL_TEXTURE_MIN_FILTER, minFilter);
+  glTextureParameteri(texGl.oglId, GL_TEXTURE_MAG_FILTER, magFilter);
+  glTextureParameteri(texGl.oglId, GL_TEXTURE_WRAP_S, wrap);
+  glTextureParameteri(texGl.oglId, GL_TEXTURE_WRAP_T, wrap);
+}
+
+// Same for a 3D texture, whose Vulkan image must be of VK_IMAGE_TYPE_3D
+inline void createTextureGL(nvvk::ResourceAllocator& alloc, Texture3DVkGL& texGl, int format, int minFilter, int magFilter, int wrap)
+{
+  const VkDeviceSize offset = importTextureMemoryGL(alloc, texGl);
+  glCreateTextures(GL_TEXTURE_3D, 1, &texGl.oglId);
+  glTextureStorageMem3DEXT(texGl.oglId, texGl.mipLevels, format, texGl.imgSize.width, texGl.imgSize.height,
+                           texGl.imgSize.depth, texGl.memoryObject, offset);
   glTextureParameteri(texGl.oglId, GL_TEXTURE_MIN_FILTER, minFilter);
   glTextureParameteri(texGl.oglId, GL_TEXTURE_MAG_FILTER, magFilter);
   glTextureParameteri(texGl.oglId, GL_TEXTURE_WRAP_S, wrap);
   glTextureParameteri(texGl.oglId, GL_TEXTURE_WRAP_T, wrap);
+  glTextureParameteri(texGl.oglId, GL_TEXTURE_WRAP_R, wrap);
 }
 
 
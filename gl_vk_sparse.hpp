@@ -0,0 +1,500 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gl_vk.hpp"
+#include "nvvk/images_vk.hpp"
+
+namespace nvvk {
+
+// What the device and the OpenGL driver offer for sharing a sparse-resident image
+struct SparseInteropSupport
+{
+  bool        supported{false};
+  std::string reason;                    // Why it is not supported, for the report
+  VkExtent2D  pageSize{0, 0};            // Size of a page (sparse block) in texels
+  GLint       glPageSizeIndex{0};        // Matching GL_VIRTUAL_PAGE_SIZE_INDEX_ARB
+  bool        nonResidentStrict{false};  // Non-resident pages read as zero, otherwise undefined
+};
+
+// Check every piece needed by SparseTexture2DVkGL: sparse residency in Vulkan, export of sparse
+// images, a sparse binding queue, and sparse textures backed by memory objects in OpenGL
+// (GL_ARB_sparse_texture + GL_NV_memory_object_sparse) with the same page size.
+inline SparseInteropSupport querySparseInteropSupport(VkPhysicalDevice physicalDevice,
+                                                      uint32_t         queueFamily,
+                                                      VkFormat         format,
+                                                      GLenum           glFormat)
+{
+  SparseInteropSupport support;
+
+  VkPhysicalDeviceFeatures features{};
+  vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+  if(!features.sparseBinding || !features.sparseResidencyImage2D)
+  {
+    support.reason = "the device has no sparseBinding/sparseResidencyImage2D";
+    return support;
+  }
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  if(!properties.sparseProperties.residencyStandard2DBlockShape)
+  {
+    // Without the standard block shape, nothing guarantees OpenGL sees the same texel layout in a page
+    support.reason = "the device does not use the standard sparse block shape";
+    return support;
+  }
+  support.nonResidentStrict = properties.sparseProperties.residencyNonResidentStrict;
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+  if(queueFamily >= familyCount || !(families[queueFamily].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT))
+  {
+    support.reason = "the compute queue family has no sparse binding";
+    return support;
+  }
+
+#ifdef WIN32
+  const auto handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_BIT;
+#else
+  const auto handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+#endif
+  const VkImageUsageFlags  usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+  const VkImageCreateFlags flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+
+  VkPhysicalDeviceExternalImageFormatInfo externalInfo{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO,
+                                                       .handleType = handleType};
+  VkPhysicalDeviceImageFormatInfo2 formatInfo{.sType  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2,
+                                              .pNext  = &externalInfo,
+                                              .format = format,
+                                              .type   = VK_IMAGE_TYPE_2D,
+                                              .tiling = VK_IMAGE_TILING_OPTIMAL,
+                                              .usage  = usage,
+                                              .flags  = flags};
+  VkExternalImageFormatProperties externalProperties{.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES};
+  VkImageFormatProperties2 formatProperties{.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2, .pNext = &externalProperties};
+  if(vkGetPhysicalDeviceImageFormatProperties2(physicalDevice, &formatInfo, &formatProperties) != VK_SUCCESS)
+  {
+    support.reason = "sparse images with external memory are not supported for this format";
+    return support;
+  }
+  if(!(externalProperties.externalMemoryProperties.externalMemoryFeatures & VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT))
+  {
+    support.reason = "memory of sparse images cannot be exported";
+    return support;
+  }
+
+  uint32_t sparseCount = 0;
+  vkGetPhysicalDeviceSparseImageFormatProperties(physicalDevice, format, VK_IMAGE_TYPE_2D, VK_SAMPLE_COUNT_1_BIT, usage,
+                                                 VK_IMAGE_TILING_OPTIMAL, &sparseCount, nullptr);
+  std::vector<VkSparseImageFormatProperties> sparseProperties(sparseCount);
+  vkGetPhysicalDeviceSparseImageFormatProperties(physicalDevice, format, VK_IMAGE_TYPE_2D, VK_SAMPLE_COUNT_1_BIT, usage,
+                                                 VK_IMAGE_TILING_OPTIMAL, &sparseCount, sparseProperties.data());
+  auto color = std::find_if(sparseProperties.begin(), sparseProperties.end(), [](const VkSparseImageFormatProperties& p) {
+    return (p.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) != 0;
+  });
+  if(color == sparseProperties.end())
+  {
+    support.reason = "no sparse image format properties for this format";
+    return support;
+  }
+  support.pageSize = {color->imageGranularity.width, color->imageGranularity.height};
+
+  if(!has_GL_ARB_sparse_texture || !has_GL_NV_memory_object_sparse)
+  {
+    support.reason = "OpenGL lacks GL_ARB_sparse_texture or GL_NV_memory_object_sparse";
+    return support;
+  }
+
+  // OpenGL must be able to use the same page size as Vulkan
+  GLint glPageSizes = 0;
+  glGetInternalformativ(GL_TEXTURE_2D, glFormat, GL_NUM_VIRTUAL_PAGE_SIZES_ARB, 1, &glPageSizes);
+  std::vector<GLint> pageX(std::max(glPageSizes, 1)), pageY(std::max(glPageSizes, 1));
+  glGetInternalformativ(GL_TEXTURE_2D, glFormat, GL_VIRTUAL_PAGE_SIZE_X_ARB, glPageSizes, pageX.data());
+  glGetInternalformativ(GL_TEXTURE_2D, glFormat, GL_VIRTUAL_PAGE_SIZE_Y_ARB, glPageSizes, pageY.data());
+  for(GLint i = 0; i < glPageSizes; i++)
+  {
+    if(uint32_t(pageX[i]) == support.pageSize.width && uint32_t(pageY[i]) == support.pageSize.height)
+    {
+      support.glPageSizeIndex = i;
+      support.supported       = true;
+      return support;
+    }
+  }
+  support.reason = "OpenGL has no virtual page size matching the Vulkan sparse block";
+  return support;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Sparse-resident image shared with OpenGL.
+// Only a rectangle of pages is backed by memory. Pages come from exportable memory chunks, each
+// imported once as an OpenGL memory object; a page is bound with vkQueueBindSparse in Vulkan and
+// committed with glTexturePageCommitmentMemNV at the same memory offset in OpenGL.
+//
+class SparseTexture2DVkGL
+{
+public:
+  // Creates the image, its view, and the OpenGL texture, and fills `texture` with them. No memory is
+  // resident until setResidentRegion() is called.
+  void create(VkDevice                    device,
+              VkPhysicalDevice            physicalDevice,
+              const SparseInteropSupport& support,
+              VkExtent2D                  extent,
+              VkFormat                    format,
+              GLenum                      glFormat,
+              Texture2DVkGL&              texture)
+  {
+    m_device   = device;
+    m_pageSize = support.pageSize;
+    m_extent   = extent;
+    m_columns  = (extent.width + m_pageSize.width - 1) / m_pageSize.width;
+    m_rows     = (extent.height + m_pageSize.height - 1) / m_pageSize.height;
+    m_pageSlots.assign(size_t(m_columns) * m_rows, kNotResident);
+    m_resident = {};
+
+#ifdef WIN32
+    const auto handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_BIT;
+#else
+    const auto handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+#endif
+    VkExternalMemoryImageCreateInfo externalInfo{.sType       = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+                                                 .handleTypes = VkExternalMemoryHandleTypeFlags(handleType)};
+    VkImageCreateInfo imageCreateInfo{.sType     = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                                      .pNext     = &externalInfo,
+                                      .flags     = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT,
+                                      .imageType = VK_IMAGE_TYPE_2D,
+                                      .format    = format,
+                                      .extent    = VkExtent3D{extent.width, extent.height, 1},
+                                      .mipLevels = 1,
+                                      .arrayLayers = 1,
+                                      .samples     = VK_SAMPLE_COUNT_1_BIT,
+                                      .tiling      = VK_IMAGE_TILING_OPTIMAL,
+                                      .usage       = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT};
+    NVVK_CHECK(vkCreateImage(device, &imageCreateInfo, nullptr, &m_image));
+
+    // With a single mip level, every page has the size of the memory alignment
+    VkMemoryRequirements requirements{};
+    vkGetImageMemoryRequirements(device, m_image, &requirements);
+    m_pageBytes = requirements.alignment;
+
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    for(uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+      if((requirements.memoryTypeBits & (1u << i))
+         && (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+      {
+        m_memoryTypeIndex = i;
+        break;
+      }
+    }
+
+    VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(m_image, imageCreateInfo);
+    NVVK_CHECK(vkCreateImageView(device, &ivInfo, nullptr, &m_imageView));
+
+    // The OpenGL texture is sparse too; its pages get committed to the memory of the Vulkan pages
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_glTexture);
+    glTextureParameteri(m_glTexture, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+    glTextureParameteri(m_glTexture, GL_VIRTUAL_PAGE_SIZE_INDEX_ARB, support.glPageSizeIndex);
+    glTextureStorage2D(m_glTexture, 1, glFormat, extent.width, extent.height);
+    glTextureParameteri(m_glTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(m_glTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(m_glTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_glTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // An image smaller than a page lives in the mip tail, and some formats need metadata: neither is
+    // bound per page, they are bound once, in full, by the first setResidentRegion()
+    uint32_t requirementCount = 0;
+    vkGetImageSparseMemoryRequirements(device, m_image, &requirementCount, nullptr);
+    std::vector<VkSparseImageMemoryRequirements> sparseRequirements(requirementCount);
+    vkGetImageSparseMemoryRequirements(device, m_image, &requirementCount, sparseRequirements.data());
+    VkDeviceSize colorTailOffset = 0;
+    for(const auto& sparse : sparseRequirements)
+    {
+      const bool metadata = (sparse.formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT) != 0;
+      if(!metadata && sparse.imageMipTailFirstLod >= imageCreateInfo.mipLevels)
+        continue;
+      if(!metadata)
+      {
+        m_colorTail     = true;
+        colorTailOffset = m_tailBytes;
+      }
+      m_tailBinds.push_back({.resourceOffset = sparse.imageMipTailOffset,
+                             .size           = sparse.imageMipTailSize,
+                             .memoryOffset   = m_tailBytes,
+                             .flags          = metadata ? VkSparseMemoryBindFlags(VK_SPARSE_MEMORY_BIND_METADATA_BIT) : 0u});
+      m_tailBytes += (sparse.imageMipTailSize + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+    }
+    if(m_tailBytes > 0)
+    {
+      allocateShared(m_tailBytes, m_tail);
+      for(auto& bind : m_tailBinds)
+        bind.memory = m_tail.memory;
+    }
+    // The whole image is in the mip tail: OpenGL commits it at once, and there are no pages
+    if(m_colorTail)
+    {
+      glTexturePageCommitmentMemNV(m_glTexture, 0, 0, 0, 0, 0, extent.width, extent.height, 1, m_tail.glMemory,
+                                   colorTailOffset, GL_TRUE);
+      m_pageSlots.clear();
+      m_resident = {{0, 0}, extent};
+    }
+    m_tailPending = !m_tailBinds.empty();
+
+    texture                            = {};
+    texture.texVk.image                = m_image;
+    texture.texVk.descriptor.imageView = m_imageView;
+    texture.imgSize                    = extent;
+    texture.oglId                      = m_glTexture;
+  }
+
+  void destroy()
+  {
+    if(m_image == VK_NULL_HANDLE)
+      return;
+    glDeleteTextures(1, &m_glTexture);
+    vkDestroyImageView(m_device, m_imageView, nullptr);
+    vkDestroyImage(m_device, m_image, nullptr);
+    for(auto& chunk : m_chunks)
+    {
+      glDeleteMemoryObjectsEXT(1, &chunk.glMemory);
+      vkFreeMemory(m_device, chunk.memory, nullptr);
+    }
+    m_chunks.clear();
+    if(m_tail.memory != VK_NULL_HANDLE)
+    {
+      glDeleteMemoryObjectsEXT(1, &m_tail.glMemory);
+      vkFreeMemory(m_device, m_tail.memory, nullptr);
+    }
+    m_tail = {};
+    m_tailBinds.clear();
+    m_tailBytes   = 0;
+    m_colorTail   = false;
+    m_tailPending = false;
+    m_freeSlots.clear();
+    m_pageSlots.clear();
+    m_image     = VK_NULL_HANDLE;
+    m_imageView = VK_NULL_HANDLE;
+    m_glTexture = 0;
+  }
+
+  bool isValid() const { return m_image != VK_NULL_HANDLE; }
+
+  // Make the pages covering `region` (in texels) resident and evict all others. The pages must not be
+  // in use by Vulkan. The bindings wait on `wait`, signaled by OpenGL once it is done sampling the
+  // image, since evicted pages may still be read there. Returns true when bindings were queued: `wait`
+  // is then consumed, and `signal` is signaled once they are done and must be waited on instead.
+  bool setResidentRegion(VkQueue queue, VkRect2D region, VkSemaphore wait, VkSemaphore signal)
+  {
+    if(m_colorTail)
+      return submitBinds(queue, {}, wait, signal);
+
+    const uint32_t px0 = std::min(uint32_t(region.offset.x) / m_pageSize.width, m_columns);
+    const uint32_t py0 = std::min(uint32_t(region.offset.y) / m_pageSize.height, m_rows);
+    const uint32_t px1 =
+        std::min((region.offset.x + region.extent.width + m_pageSize.width - 1) / m_pageSize.width, m_columns);
+    const uint32_t py1 =
+        std::min((region.offset.y + region.extent.height + m_pageSize.height - 1) / m_pageSize.height, m_rows);
+
+    std::vector<VkSparseImageMemoryBind> binds;
+    std::vector<uint32_t>                released;
+    for(uint32_t py = 0; py < m_rows; py++)
+    {
+      for(uint32_t px = 0; px < m_columns; px++)
+      {
+        uint32_t&  slot   = m_pageSlots[py * m_columns + px];
+        const bool inside = px >= px0 && px < px1 && py >= py0 && py < py1;
+        if(inside == (slot != kNotResident))
+          continue;
+
+        VkSparseImageMemoryBind bind{.subresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT},
+                                     .offset = {int32_t(px * m_pageSize.width), int32_t(py * m_pageSize.height), 0},
+                                     .extent = pageExtent(px, py)};
+        if(inside)
+        {
+          slot              = allocateSlot();
+          bind.memory       = m_chunks[slot / kPagesPerChunk].memory;
+          bind.memoryOffset = VkDeviceSize(slot % kPagesPerChunk) * m_pageBytes;
+        }
+        else
+        {
+          // Slots are only recycled after this batch, a page never moves within one vkQueueBindSparse
+          released.push_back(slot);
+          slot = kNotResident;
+        }
+        commitGL(bind, inside);
+        binds.push_back(bind);
+      }
+    }
+    m_freeSlots.insert(m_freeSlots.end(), released.begin(), released.end());
+
+    // Only full pages are resident: the region that can be written and read
+    m_resident.offset = {int32_t(px0 * m_pageSize.width), int32_t(py0 * m_pageSize.height)};
+    m_resident.extent = {std::min(px1 * m_pageSize.width, m_extent.width) - uint32_t(m_resident.offset.x),
+                         std::min(py1 * m_pageSize.height, m_extent.height) - uint32_t(m_resident.offset.y)};
+    if(px1 <= px0 || py1 <= py0)
+      m_resident = {};
+
+    return submitBinds(queue, binds, wait, signal);
+  }
+
+  VkRect2D     residentRegion() const { return m_resident; }
+  size_t       residentPages() const { return m_chunks.size() * kPagesPerChunk - m_freeSlots.size(); }
+  VkDeviceSize residentBytes() const { return VkDeviceSize(residentPages()) * m_pageBytes + m_tailBytes; }
+  VkDeviceSize allocatedBytes() const { return VkDeviceSize(m_chunks.size()) * kPagesPerChunk * m_pageBytes + m_tailBytes; }
+  VkDeviceSize fullBytes() const { return VkDeviceSize(m_pageSlots.size()) * m_pageBytes + m_tailBytes; }
+
+private:
+  static constexpr uint32_t kPagesPerChunk = 64;  // 4 MB chunks with 64 KB pages
+  static constexpr uint32_t kNotResident   = ~0u;
+
+  struct Chunk
+  {
+    VkDeviceMemory memory{};
+    GLuint         glMemory{0};
+  };
+
+  // Pages on the right and bottom border stop at the image border
+  VkExtent3D pageExtent(uint32_t px, uint32_t py) const
+  {
+    return {std::min(m_pageSize.width, m_extent.width - px * m_pageSize.width),
+            std::min(m_pageSize.height, m_extent.height - py * m_pageSize.height), 1};
+  }
+
+  // Queue the page bindings, and the mip tail and metadata bindings the first time
+  bool submitBinds(VkQueue queue, const std::vector<VkSparseImageMemoryBind>& binds, VkSemaphore wait, VkSemaphore signal)
+  {
+    if(binds.empty() && !m_tailPending)
+      return false;
+
+    VkSparseImageMemoryBindInfo imageBinds{.image = m_image, .bindCount = uint32_t(binds.size()), .pBinds = binds.data()};
+    VkSparseImageOpaqueMemoryBindInfo opaqueBinds{.image     = m_image,
+                                                  .bindCount = uint32_t(m_tailBinds.size()),
+                                                  .pBinds    = m_tailBinds.data()};
+    VkBindSparseInfo bindInfo{.sType                = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO,
+                              .waitSemaphoreCount   = 1,
+                              .pWaitSemaphores      = &wait,
+                              .imageOpaqueBindCount = m_tailPending ? 1u : 0u,
+                              .pImageOpaqueBinds    = &opaqueBinds,
+                              .imageBindCount       = binds.empty() ? 0u : 1u,
+                              .pImageBinds          = &imageBinds,
+                              .signalSemaphoreCount = 1,
+                              .pSignalSemaphores    = &signal};
+    NVVK_CHECK(vkQueueBindSparse(queue, 1, &bindInfo, VK_NULL_HANDLE));
+    m_tailPending = false;
+    return true;
+  }
+
+  uint32_t allocateSlot()
+  {
+    if(m_freeSlots.empty())
+      addChunk();
+    uint32_t slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    return slot;
+  }
+
+  // Add kPagesPerChunk free pages
+  void addChunk()
+  {
+    Chunk chunk;
+    allocateShared(VkDeviceSize(kPagesPerChunk) * m_pageBytes, chunk);
+
+    const uint32_t first = uint32_t(m_chunks.size()) * kPagesPerChunk;
+    m_chunks.push_back(chunk);
+    for(uint32_t i = kPagesPerChunk; i > 0; i--)
+      m_freeSlots.push_back(first + i - 1);
+  }
+
+  // Allocate exportable memory and import it in OpenGL
+  void allocateShared(VkDeviceSize size, Chunk& chunk)
+  {
+#ifdef WIN32
+    VkExportMemoryAllocateInfo exportInfo{.sType       = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,
+                                          .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_BIT};
+#else
+    VkExportMemoryAllocateInfo exportInfo{.sType       = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,
+                                          .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT};
+#endif
+    VkMemoryAllocateInfo allocInfo{.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                                   .pNext           = &exportInfo,
+                                   .allocationSize  = size,
+                                   .memoryTypeIndex = m_memoryTypeIndex};
+    NVVK_CHECK(vkAllocateMemory(m_device, &allocInfo, nullptr, &chunk.memory));
+
+    glCreateMemoryObjectsEXT(1, &chunk.glMemory);
+#ifdef WIN32
+    HANDLE                        handle{};
+    VkMemoryGetWin32HandleInfoKHR getInfo{.sType      = VK_STRUCTURE_TYPE_MEMORY_GET_WIN32_HANDLE_INFO_KHR,
+                                          .memory     = chunk.memory,
+                                          .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_WIN32_BIT_KHR};
+    NVVK_CHECK(vkGetMemoryWin32HandleKHR(m_device, &getInfo, &handle));
+    glImportMemoryWin32HandleEXT(chunk.glMemory, size, GL_HANDLE_TYPE_OPAQUE_WIN32_EXT, handle);
+    CloseHandle(handle);
+#else
+    int                  fd{-1};
+    VkMemoryGetFdInfoKHR getInfo{.sType      = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR,
+                                 .memory     = chunk.memory,
+                                 .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT_KHR};
+    NVVK_CHECK(vkGetMemoryFdKHR(m_device, &getInfo, &fd));
+    // fd gets consumed
+    glImportMemoryFdEXT(chunk.glMemory, size, GL_HANDLE_TYPE_OPAQUE_FD_EXT, fd);
+#endif
+  }
+
+  // Mirror a Vulkan page binding on the OpenGL texture
+  void commitGL(const VkSparseImageMemoryBind& bind, bool commit)
+  {
+    GLuint glMemory = 0;
+    for(const auto& chunk : m_chunks)
+      if(chunk.memory == bind.memory)
+        glMemory = chunk.glMemory;
+    glTexturePageCommitmentMemNV(m_glTexture, 0, 0, bind.offset.x, bind.offset.y, 0, bind.extent.width,
+                                 bind.extent.height, 1, glMemory, bind.memoryOffset, commit ? GL_TRUE : GL_FALSE);
+  }
+
+  VkDevice                        m_device{};
+  VkImage                         m_image{};
+  VkImageView                     m_imageView{};
+  GLuint                          m_glTexture{0};
+  VkExtent2D                      m_extent{0, 0};
+  VkExtent2D                      m_pageSize{0, 0};
+  VkDeviceSize                    m_pageBytes{0};
+  uint32_t                        m_memoryTypeIndex{0};
+  uint32_t                        m_columns{0};
+  uint32_t                        m_rows{0};
+  std::vector<Chunk>              m_chunks;
+  std::vector<uint32_t>           m_freeSlots;
+  std::vector<uint32_t>           m_pageSlots;  // Slot of each page in the chunks, or kNotResident
+  VkRect2D                        m_resident{};
+  Chunk                           m_tail;  // Memory of the mip tail and metadata
+  VkDeviceSize                    m_tailBytes{0};
+  std::vector<VkSparseMemoryBind> m_tailBinds;
+  bool                            m_colorTail{false};    // The whole image is in the mip tail
+  bool                            m_tailPending{false};  // m_tailBinds are not queued yet
+};
+
+}  // namespace nvvk
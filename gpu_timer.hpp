@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include <nvgl/extensions_gl.hpp>
+#include "nvvk/error_vk.hpp"
+
+namespace nvvk {
+
+//--------------------------------------------------------------------------------------------------
+// GPU time between two points of a command buffer, with a pair of timestamp queries.
+// The measurement of a submission is read when recording the next one, which the caller must only
+// do once the previous submission is complete (after its fence).
+//
+class GpuTimer
+{
+public:
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily)
+  {
+    m_device = device;
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_periodNs = properties.limits.timestampPeriod;
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    if(queueFamily >= familyCount || families[queueFamily].timestampValidBits == 0)
+      return;
+
+    VkQueryPoolCreateInfo poolInfo{.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, .queryType = VK_QUERY_TYPE_TIMESTAMP, .queryCount = 2};
+    NVVK_CHECK(vkCreateQueryPool(device, &poolInfo, nullptr, &m_pool));
+  }
+
+  void deinit()
+  {
+    if(m_pool != VK_NULL_HANDLE)
+      vkDestroyQueryPool(m_device, m_pool, nullptr);
+    m_pool    = VK_NULL_HANDLE;
+    m_pending = false;
+    m_lastMs  = -1.0;
+  }
+
+  // False when the queue family has no timestamps
+  bool isValid() const { return m_pool != VK_NULL_HANDLE; }
+
+  void begin(VkCommandBuffer cmd)
+  {
+    if(!isValid())
+      return;
+    collect();
+    vkCmdResetQueryPool(cmd, m_pool, 0, 2);
+    // Once the previous commands are complete
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_pool, 0);
+  }
+
+  void end(VkCommandBuffer cmd)
+  {
+    if(!isValid())
+      return;
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_pool, 1);
+    m_pending = true;
+  }
+
+  // Of the last measurement read, negative if there is none
+  double lastMs() const { return m_lastMs; }
+
+private:
+  void collect()
+  {
+    if(!m_pending)
+      return;
+    uint64_t timestamps[2]{};
+    if(vkGetQueryPoolResults(m_device, m_pool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT)
+       == VK_SUCCESS)
+      m_lastMs = double(timestamps[1] - timestamps[0]) * double(m_periodNs) * 1e-6;
+    m_pending = false;
+  }
+
+  VkDevice    m_device{};
+  VkQueryPool m_pool{};
+  float       m_periodNs{1.f};   // Nanoseconds per timestamp tick
+  bool        m_pending{false};  // Timestamps written by the last recording, not read yet
+  double      m_lastMs{-1.0};
+};
+
+}  // namespace nvvk
+
+namespace nvgl {
+
+//--------------------------------------------------------------------------------------------------
+// GPU time of the OpenGL commands between begin() and end(), with GL_TIME_ELAPSED queries. Results
+// are read frames later, once available, so that reading them never stalls the pipeline.
+//
+class GpuTimer
+{
+public:
+  void init() { glCreateQueries(GL_TIME_ELAPSED, kQueryCount, m_queries); }
+
+  void deinit()
+  {
+    glDeleteQueries(kQueryCount, m_queries);
+    m_pending = 0;
+    m_lastMs  = -1.0;
+  }
+
+  void begin()
+  {
+    collect();
+    // All queries in flight: the oldest result is dropped
+    if(m_pending == kQueryCount)
+      m_pending--;
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+  }
+
+  void end()
+  {
+    glEndQuery(GL_TIME_ELAPSED);
+    m_next = (m_next + 1) % kQueryCount;
+    m_pending++;
+  }
+
+  // Of the last measurement read, negative if there is none
+  double lastMs() const { return m_lastMs; }
+
+private:
+  static constexpr uint32_t kQueryCount = 4;
+
+  // Reads the pending queries in order, up to the first one not available yet
+  void collect()
+  {
+    while(m_pending > 0)
+    {
+      const GLuint query     = m_queries[(m_next + kQueryCount - m_pending) % kQueryCount];
+      GLint        available = 0;
+      glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if(!available)
+        break;
+      GLuint64 elapsedNs = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsedNs);
+      m_lastMs = double(elapsedNs) * 1e-6;
+      m_pending--;
+    }
+  }
+
+  GLuint   m_queries[kQueryCount]{};
+  uint32_t m_next{0};     // Query of the next begin()
+  uint32_t m_pending{0};  // Ended and not read yet, the ones before m_next
+  double   m_lastMs{-1.0};
+};
+
+}  // namespace nvgl
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <vector>
+
+#include "interop_state.hpp"
+
+namespace nvvk {
+
+//--------------------------------------------------------------------------------------------------
+// Interop buffers and textures handed over between OpenGL and Vulkan with one pair of semaphores,
+// the one of a Vulkan submission. signal() and wait() make a single semaphore operation for all
+// of them, with the texture layouts given by their InteropImageState. Textures are only part of it
+// when OpenGL has them: one Vulkan keeps is skipped, see InteropImageState::handedToGL().
+//
+class InteropBatch
+{
+public:
+  void addBuffer(GLuint buffer) { m_buffers.push_back(buffer); }
+
+  // `vkLayout` is the layout Vulkan uses the texture in
+  void addTexture(InteropImageState& state, VkImageLayout vkLayout)
+  {
+    m_states.push_back(&state);
+    m_vkLayouts.push_back(vkLayout);
+  }
+
+  void clear()
+  {
+    m_buffers.clear();
+    m_states.clear();
+    m_vkLayouts.clear();
+  }
+
+  bool empty() const { return m_buffers.empty() && m_states.empty(); }
+
+  // OpenGL -> Vulkan
+  void signal(GLuint semaphore)
+  {
+    m_textures.clear();
+    m_glLayouts.clear();
+    for(size_t i = 0; i < m_states.size(); i++)
+    {
+      if(!m_states[i]->handedToGL())
+        continue;
+      m_textures.push_back(m_states[i]->texture());
+      m_glLayouts.push_back(m_states[i]->signalGL(m_vkLayouts[i]));
+    }
+    glSignalSemaphoreEXT(semaphore, GLuint(m_buffers.size()), m_buffers.data(), GLuint(m_textures.size()),
+                         m_textures.data(), m_glLayouts.data());
+  }
+
+  // Vulkan -> OpenGL
+  void wait(GLuint semaphore)
+  {
+    m_textures.clear();
+    m_glLayouts.clear();
+    for(InteropImageState* state : m_states)
+    {
+      if(!state->handedToGL())
+        continue;
+      m_textures.push_back(state->texture());
+      m_glLayouts.push_back(state->waitGL());
+    }
+    glWaitSemaphoreEXT(semaphore, GLuint(m_buffers.size()), m_buffers.data(), GLuint(m_textures.size()),
+                       m_textures.data(), m_glLayouts.data());
+  }
+
+private:
+  std::vector<GLuint>             m_buffers;
+  std::vector<InteropImageState*> m_states;
+  std::vector<VkImageLayout>      m_vkLayouts;
+  std::vector<GLuint>             m_textures;   // Of the current semaphore operation
+  std::vector<GLenum>             m_glLayouts;
+};
+
+//--------------------------------------------------------------------------------------------------
+// All interop resources touched in a frame, grouped by the semaphores of the Vulkan submission
+// that uses them. Each frame:
+// - beginFrame()
+// - batch() for each submission, then add its resources to it
+// - signalAll() before submitting, waitAll() after
+// There is one semaphore operation per submission and direction, however many resources are added.
+//
+class InteropRegistry
+{
+public:
+  void beginFrame()
+  {
+    for(Entry& entry : m_entries)
+      entry.batch.clear();
+    m_used = 0;
+  }
+
+  // Batch of the submission waiting on `glReady` and signaling `glComplete`
+  InteropBatch& batch(GLuint glReady, GLuint glComplete)
+  {
+    for(size_t i = 0; i < m_used; i++)
+    {
+      if(m_entries[i].glReady == glReady && m_entries[i].glComplete == glComplete)
+        return m_entries[i].batch;
+    }
+    // Entries are reused across frames, so that the arrays keep their capacity
+    if(m_used == m_entries.size())
+      m_entries.emplace_back();
+    Entry& entry     = m_entries[m_used++];
+    entry.glReady    = glReady;
+    entry.glComplete = glComplete;
+    return entry.batch;
+  }
+
+  void signalAll()
+  {
+    for(size_t i = 0; i < m_used; i++)
+      m_entries[i].batch.signal(m_entries[i].glReady);
+  }
+
+  void waitAll()
+  {
+    for(size_t i = 0; i < m_used; i++)
+      m_entries[i].batch.wait(m_entries[i].glComplete);
+  }
+
+  // Semaphore operations per direction in the current frame
+  size_t batchCount() const { return m_used; }
+
+private:
+  struct Entry
+  {
+    GLuint       glReady{0};
+    GLuint       glComplete{0};
+    InteropBatch batch;
+  };
+  std::vector<Entry> m_entries;
+  size_t             m_used{0};
+};
+
+}  // namespace nvvk
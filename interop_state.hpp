@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cassert>
+
+#include <vulkan/vulkan_core.h>
+#include <nvgl/extensions_gl.hpp>
+
+namespace nvvk {
+
+// Layout to pass to glSignalSemaphoreEXT / glWaitSemaphoreEXT for an image in `layout` on the Vulkan side
+inline GLenum glLayoutFromVk(VkImageLayout layout)
+{
+  switch(layout)
+  {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+      return GL_NONE;
+    case VK_IMAGE_LAYOUT_GENERAL:
+      return GL_LAYOUT_GENERAL_EXT;
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+      return GL_LAYOUT_COLOR_ATTACHMENT_EXT;
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+      return GL_LAYOUT_DEPTH_STENCIL_ATTACHMENT_EXT;
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+      return GL_LAYOUT_DEPTH_STENCIL_READ_ONLY_EXT;
+    case VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL:
+      return GL_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_EXT;
+    case VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_STENCIL_READ_ONLY_OPTIMAL:
+      return GL_LAYOUT_DEPTH_ATTACHMENT_STENCIL_READ_ONLY_EXT;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+      return GL_LAYOUT_SHADER_READ_ONLY_EXT;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+      return GL_LAYOUT_TRANSFER_SRC_EXT;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+      return GL_LAYOUT_TRANSFER_DST_EXT;
+    default:
+      assert(!"layout has no OpenGL equivalent");
+      return GL_NONE;
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Tracks the layout and owner API of an interop image, and emits only the transitions needed
+// when it goes back and forth between OpenGL and Vulkan:
+// - OpenGL hands the image over with glSignalSemaphoreEXT, directly in the layout Vulkan uses
+//   next: signalGL() returns that layout
+// - Vulkan acquires it from VK_QUEUE_FAMILY_EXTERNAL, changing the layout only if needed
+// - Vulkan releases it to VK_QUEUE_FAMILY_EXTERNAL in the layout it is in, which is the layout
+//   waitGL() returns for glWaitSemaphoreEXT
+// When both sides agree on the layout, no layout change happens on either side.
+// A new image starts UNDEFINED: its first acquireVk() initializes the layout in the command buffer,
+// so creating images never needs a submission of its own.
+// An image Vulkan keeps (new, or acquired and not released) is owned by Vulkan, and is left out of
+// the semaphore operations, see handedToGL().
+//
+class InteropImageState
+{
+public:
+  enum Owner
+  {
+    eVulkan,
+    eOpenGL,
+  };
+
+  // Image owned by Vulkan, in `layout`, used on `queueFamily`. `texture` is its OpenGL texture.
+  void init(VkImage image, GLuint texture, VkImageLayout layout, uint32_t queueFamily)
+  {
+    m_image       = image;
+    m_texture     = texture;
+    m_layout      = layout;
+    m_queueFamily = queueFamily;
+    m_owner       = eVulkan;
+  }
+
+  VkImageLayout layout() const { return m_layout; }
+  Owner         owner() const { return m_owner; }
+  GLuint        texture() const { return m_texture; }
+
+  // Whether OpenGL has the image, so that the semaphore operations must include it
+  bool handedToGL() const { return m_owner == eOpenGL; }
+
+  // OpenGL -> Vulkan, before glSignalSemaphoreEXT. OpenGL transitions the image to the returned layout.
+  GLenum signalGL(VkImageLayout vkLayout)
+  {
+    assert(m_owner == eOpenGL && "Vulkan already has the image");
+    m_layout = vkLayout;
+    m_owner  = eOpenGL;
+    return glLayoutFromVk(vkLayout);
+  }
+
+  // Vulkan -> OpenGL, before glWaitSemaphoreEXT: the layout Vulkan left the image in
+  GLenum waitGL() const
+  {
+    assert(m_owner == eOpenGL && "the image must be released by Vulkan first");
+    return glLayoutFromVk(m_layout);
+  }
+
+  // Records the acquire of the image by Vulkan, in `layout`. Nothing is recorded when Vulkan
+  // already owns the image in that layout.
+  void acquireVk(VkCommandBuffer cmd, VkImageLayout layout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+  {
+    const bool fromGL = m_owner == eOpenGL;
+    if(!fromGL && layout == m_layout)
+      return;
+    // Nothing to wait for when coming from OpenGL (the semaphore did) or when the content is undefined
+    const bool           noDependency = fromGL || m_layout == VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageMemoryBarrier barrier{.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                 .srcAccessMask       = noDependency ? VkAccessFlags(0) : VK_ACCESS_MEMORY_WRITE_BIT,
+                                 .dstAccessMask       = dstAccess,
+                                 .oldLayout           = m_layout,
+                                 .newLayout           = layout,
+                                 .srcQueueFamilyIndex = fromGL ? VK_QUEUE_FAMILY_EXTERNAL : VK_QUEUE_FAMILY_IGNORED,
+                                 .dstQueueFamilyIndex = fromGL ? m_queueFamily : VK_QUEUE_FAMILY_IGNORED,
+                                 .image               = m_image,
+                                 .subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0,
+                                                         VK_REMAINING_ARRAY_LAYERS}};
+    const VkPipelineStageFlags srcStage = noDependency ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    m_layout = layout;
+    m_owner  = eVulkan;
+  }
+
+  // Records the release of the image to OpenGL, keeping its layout
+  void releaseVk(VkCommandBuffer cmd, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+  {
+    assert(m_owner == eVulkan);
+    VkImageMemoryBarrier barrier{.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                 .srcAccessMask       = srcAccess,
+                                 .dstAccessMask       = 0,
+                                 .oldLayout           = m_layout,
+                                 .newLayout           = m_layout,
+                                 .srcQueueFamilyIndex = m_queueFamily,
+                                 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL,
+                                 .image               = m_image,
+                                 .subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0,
+                                                         VK_REMAINING_ARRAY_LAYERS}};
+    vkCmdPipelineBarrier(cmd, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    m_owner = eOpenGL;
+  }
+
+private:
+  VkImage       m_image{};
+  GLuint        m_texture{0};
+  VkImageLayout m_layout{VK_IMAGE_LAYOUT_UNDEFINED};
+  uint32_t      m_queueFamily{0};
+  Owner         m_owner{eVulkan};
+};
+
+}  // namespace nvvk
@@ -33,7 +33,9 @@
 #include <array>
 #include <chrono>
 #include <iostream>
+#include <memory>
 #include <vulkan/vulkan_core.h>
+#include <glm/gtc/matrix_transform.hpp>
 
 #define IMGUI_DEFINE_MATH_OPERATORS
 
@@ -41,7 +43,13 @@
 #include "imgui/imgui_helper.h"
 #include "imgui/backends/imgui_impl_gl.h"
 
+#include "benchmark.hpp"
 #include "compute.hpp"
+#include "frame_pacing.hpp"
+#include "scan.hpp"
+#include "terrain.hpp"
+#include "tiled_image.hpp"
+#include "volume.hpp"
 #include "nvgl/contextwindow_gl.hpp"
 #include "nvgl/extensions_gl.hpp"
 #include "nvpsystem.hpp"
@@ -54,6 +62,17 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 int const SAMPLE_SIZE_WIDTH  = 1200;
 int const SAMPLE_SIZE_HEIGHT = 900;
 
+// Upper bound of concurrent compute producers, each one owns its interop texture and semaphores
+uint32_t const MAX_PRODUCERS = 64;
+// Upper bound of queues requested from the compute family, producers are spread over them
+uint32_t const MAX_COMPUTE_QUEUES = 8;
+// Images in the bindless table; tiled images of all producers must fit
+uint32_t const BINDLESS_CAPACITY = 1024;
+
+// Frame rate when the window has no focus, and frames drawn after an event while paused
+double const UNFOCUSED_FPS = 10.0;
+int const    SETTLE_FRAMES = 3;
+
 // Default search path for shaders
 std::vector<std::string> defaultSearchPaths{
     "./",
@@ -83,23 +102,72 @@ static std::vector<Vertex> g_vertexDataVK = {{{-1.0f, -1.0f, 0.0f}, {0, 0}},
 class InteropExample : public nvvkhl::AppBase
 {
 public:
-  void prepare(uint32_t queueIdxCompute)
+  void prepare(uint32_t queueIdxCompute, const std::vector<uint32_t>& computeQueues, const ComputeFeatures& features)
   {
     m_alloc.init(m_device, m_physicalDevice);
+    m_pipelineCache.init(m_device, m_physicalDevice, pipelineCachePath(),
+                         features.pipelineFeedback ? &m_pipelineStats : nullptr);
 
     createShaders();   // Create the GLSL shaders
+    createTerrainProgram();
+    createVolumeProgram();
     createBufferVK();  // Create the vertex buffer
+    m_presentTimer.init();
+
+    // Initialize the Vulkan compute producers
+    m_queueIdxCompute = queueIdxCompute;
+    m_computeQueues   = computeQueues;
+    m_deviceFeatures  = features;
+    m_computeFeatures = features;
+
+    // Sparse residency needs support from both APIs, report what is missing
+    m_sparseSupport = nvvk::querySparseInteropSupport(m_physicalDevice, queueIdxCompute, kTextureFormat,
+                                                       glTextureFormat(kTextureFormat));
+    if(m_sparseSupport.supported)
+      LOGI("Sparse interop images supported, page size %u x %u\n", m_sparseSupport.pageSize.width,
+           m_sparseSupport.pageSize.height);
+    else
+      LOGW("Sparse interop images not available: %s. Using regular images.\n", m_sparseSupport.reason.c_str());
+
+    // The table always exists when supported, so that the UI can switch to it
+    if(m_deviceFeatures.bindless)
+    {
+      m_bindlessTable.init(m_device, m_physicalDevice, BINDLESS_CAPACITY, sizeof(ComputePushConstants));
+      LOGI("Bindless image table: %u images\n", m_bindlessTable.capacity());
+    }
+    // Shader binaries of the previous runs
+    if(m_deviceFeatures.shaderObject)
+    {
+      m_shaderObjectCache.init(m_device, m_physicalDevice);
+      if(m_shaderObjectCache.load(shaderObjectCachePath()))
+        LOGI("Shader object cache: %zu binaries loaded\n", m_shaderObjectCache.size());
+    }
+
+    const ComputeShaderVariant& variant = selectShaderVariant(m_physicalDevice, kTextureFormat, m_computeFeatures.bindless);
+    LOGI("Compute kernel: %s\n", variant.shader.filename);
 
-    // Initialize the Vulkan compute shader
-    m_compute.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, queueIdxCompute, m_alloc);
-    m_compute.update({1024, 1024});  // Initial size
+    setProducerCount(1);
   }
 
   void destroy() override
   {
     m_device.waitIdle();
     m_bufferVk.destroy(m_alloc);
-    m_compute.destroy();
+    m_presentTimer.deinit();
+    m_scanWorkload.deinit();
+    m_terrain.deinit();
+    glDeleteProgram(m_terrainProgram);
+    glDeleteVertexArrays(1, &m_terrainVertexArray);
+    m_volume.deinit();
+    glDeleteProgram(m_volumeProgram);
+    glDeleteVertexArrays(1, &m_volumeVertexArray);
+    setProducerCount(0);
+    m_pipelineCache.save(pipelineCachePath());
+    m_pipelineCache.deinit();
+    if(m_bindlessTable.isValid())
+      m_bindlessTable.deinit();
+    if(m_shaderObjectCache.isValid())
+      m_shaderObjectCache.save(shaderObjectCachePath());
 
     ImGui_ImplGlfw_Shutdown();
     ImGui::ShutdownGL();
@@ -131,6 +199,274 @@ public:
     glVertexArrayVertexBuffer(m_vertexArray, 0, m_bufferVk.oglId, 0, sizeof(Vertex));
   }
 
+  //--------------------------------------------------------------------------------------------------
+  // Add or remove compute producers, each with its own kernel parameters and interop texture
+  //
+  void setProducerCount(uint32_t count)
+  {
+    while(m_producers.size() > count)
+    {
+      m_producers.back()->destroy();
+      m_producers.pop_back();
+    }
+    while(m_producers.size() < count)
+    {
+      TiledImageVk& producer = *m_producers.emplace_back(std::make_unique<TiledImageVk>());
+      producer.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, m_queueIdxCompute,
+                     producerQueue(uint32_t(m_producers.size() - 1)), m_alloc, m_computeFeatures);
+      producer.setSharedResources({.bindlessTable     = &m_bindlessTable,
+                                   .shaderObjectCache = &m_shaderObjectCache,
+                                   .pipelineCache     = &m_pipelineCache});
+      producer.setHdr(m_hdr);
+      producer.setToneMapping(m_toneMapSettings);
+      producer.setVariant(m_kernelVariant);
+      producer.setParams(makeProducerParams(uint32_t(m_producers.size() - 1)));
+      producer.setMaxTileDimension(m_maxTileDimension);
+      producer.setSparse(m_useSparse ? &m_sparseSupport : nullptr);
+      producer.setIterations(uint32_t(m_pingPongIterations));
+      producer.setBlur(m_blurSettings);
+      producer.setExposure(m_exposureSettings);
+      producer.setBlockCompression(m_compressSettings);
+      producer.setSdf(m_sdfSettings);
+      producer.update(m_textureSize);
+    }
+  }
+
+  // Recreate all producers, to apply a change of m_computeFeatures
+  void recreateProducers()
+  {
+    // The selected variant may not match the bindless mode anymore
+    m_kernelVariant = nullptr;
+    const uint32_t count = uint32_t(m_producers.size());
+    setProducerCount(0);
+    setProducerCount(count);
+  }
+
+  // Switch the kernel of all producers, nullptr for the best variant. The time it takes is measured:
+  // with shader objects there is no pipeline to create, and binaries come from the cache.
+  void setKernelVariant(const ComputeShaderVariant* variant)
+  {
+    m_device.waitIdle();
+    auto start      = std::chrono::high_resolution_clock::now();
+    m_kernelVariant = variant;
+    const ComputeShaderVariant* applied =
+        variant ? variant : &selectShaderVariant(m_physicalDevice, textureFormat(), m_computeFeatures.bindless);
+    for(auto& producer : m_producers)
+      producer->setVariant(applied);
+    auto end         = std::chrono::high_resolution_clock::now();
+    m_kernelSwitchMs = std::chrono::duration<double, std::milli>(end - start).count();
+  }
+
+  VkFormat textureFormat() const { return m_hdr ? kHdrTextureFormat : kTextureFormat; }
+
+  // RGBA16F images tone mapped for display, or RGBA8. The kernel variant goes back to the best one.
+  void setHdr(bool hdr)
+  {
+    m_kernelVariant = nullptr;
+    for(auto& producer : m_producers)
+      producer->setHdr(hdr);
+  }
+
+  void setToneMapping(const ToneMapSettings& settings)
+  {
+    for(auto& producer : m_producers)
+      producer->setToneMapping(settings);
+  }
+
+  // The images are RGBA16F, or the HDR benchmark may switch them to it at any step
+  bool isHdrInUse() const { return m_hdr || m_hdrBenchmark.isRunning(); }
+
+  // Blur, exposure, compression and distance field read whole tiles, and with sparse tiles the pages
+  // outside the visible region too. What these read is undefined without residencyNonResidentStrict.
+  bool readsWholeImages() const
+  {
+    return m_blurSettings.radius > 0 || m_blurBenchmark.isRunning() || m_exposureSettings.enabled
+           || m_compressSettings.format != BlockCompressSettings::eNone || m_sdfSettings.enabled;
+  }
+  bool isWholeImageReadAllowed() const { return !m_useSparse || m_sparseSupport.nonResidentStrict; }
+
+  // HDR needs images only the kernel, the exposure and the tone mapping handle
+  bool isHdrAvailable() const { return !m_useSparse && m_pingPongIterations == 0 && m_blurSettings.radius == 0; }
+
+  // Cost of HDR: RGBA8, against RGBA16F tone mapped by OpenGL when displayed, or by a compute pass
+  void startHdrBenchmark()
+  {
+    m_hdrBenchmark.start({"RGBA8", "RGBA16F, present shader", "RGBA16F, compute pass"}, {512, 1024, 2048, 4096});
+  }
+
+  // Configuration of a step of the HDR benchmark: square images of the size in `param`
+  void applyHdrBenchmarkStep(const GpuPassBenchmark::Step& step)
+  {
+    const bool hdr = step.variant != 0;
+    if(hdr != m_producers[0]->m_tiles[0]->isHdr())
+      setHdr(hdr);
+    ToneMapSettings toneMapping = m_toneMapSettings;
+    toneMapping.location        = step.variant == 2 ? ToneMapSettings::eCompute : ToneMapSettings::eDisplay;
+    setToneMapping(toneMapping);
+    const VkExtent2D size = {step.param, step.param};
+    if(memcmp(&size, &m_producers[0]->m_extent, sizeof(VkExtent2D)) != 0)
+    {
+      for(auto& producer : m_producers)
+        producer->update(size);
+    }
+  }
+
+  // GPU time of a frame: the kernels of all producers, and the OpenGL present pass. Negative until
+  // all of them are measured.
+  double frameGpuMs() const
+  {
+    double total = m_presentTimer.lastMs();
+    if(total < 0.0)
+      return -1.0;
+    for(const auto& producer : m_producers)
+      for(const auto& tile : producer->m_tiles)
+      {
+        const double ms = tile->computeGpuMs();
+        if(ms < 0.0)
+          return -1.0;
+        total += ms;
+      }
+    return total;
+  }
+
+  void setBlur(const BlurSettings& settings)
+  {
+    for(auto& producer : m_producers)
+      producer->setBlur(settings);
+  }
+
+  // Blur radius by implementation, on the image of the first producer's first tile. The radii go up
+  // to where the FFT convolution, whose cost does not depend on the radius, wins.
+  void startBlurBenchmark()
+  {
+    std::vector<std::string> variants = {"Naive 2D", "Separable fp32", "FFT"};
+    if(BlurPass::isFp16Supported(m_physicalDevice))
+      variants.push_back("Separable fp16");
+    const VkExtent2D       tileSize       = m_producers[0]->m_tiles[0]->m_textureTarget.imgSize;
+    const VkPhysicalDevice physicalDevice = m_physicalDevice;
+    m_blurBenchmark.start(variants, {1, 2, 4, 8, 16, 32, 64, 128, 256, 512},
+                          [tileSize, physicalDevice](const GpuPassBenchmark::Step& step) {
+      const BlurSettings::Mode mode = kBlurBenchmarkModes[step.variant];
+      if(mode == BlurSettings::eFft)
+        return FftConvolutionPass::fits(physicalDevice, tileSize, step.param);
+      // The naive blur reads (2 * radius + 1)^2 pixels, larger radii would take too long
+      return step.param <= (mode == BlurSettings::eNaive ? 32u : BlurPass::kMaxRadius);
+    });
+  }
+
+  static constexpr BlurSettings::Mode kBlurBenchmarkModes[4] = {BlurSettings::eNaive, BlurSettings::eSeparable,
+                                                                 BlurSettings::eFft, BlurSettings::eSeparable};
+
+  BlurSettings blurBenchmarkSettings(const GpuPassBenchmark::Step& step) const
+  {
+    return {.radius   = step.param,
+            .gaussian = m_blurSettings.gaussian,
+            .mode     = kBlurBenchmarkModes[step.variant],
+            .fp16     = step.variant == 3};
+  }
+
+  // Creates the terrain when first enabled, and its resources when the resolution changes
+  void setTerrain(const TerrainSettings& settings)
+  {
+    if(settings.enabled && !m_terrain.isValid())
+      m_terrain.init(m_device, m_physicalDevice, m_pipelineCache, m_alloc, m_queueIdxCompute);
+    if(settings.enabled && m_terrain.resolution() != settings.resolution)
+      m_terrain.resize(settings.resolution);
+    m_terrainSettings = settings;
+  }
+
+  // Creates the volume when first enabled, and its images when the resolution changes
+  void setVolume(const VolumeSettings& settings)
+  {
+    if(settings.enabled && !m_volume.isValid())
+      m_volume.init(m_device, m_physicalDevice, m_pipelineCache, m_alloc, m_queueIdxCompute);
+    if(settings.enabled && m_volume.resolution() != settings.resolution)
+      m_volume.resize(settings.resolution);
+    m_volumeSettings = settings;
+  }
+
+  // The frame times are measured without vsync, which would cap them at the display refresh. The
+  // swap mode is restored when the benchmark ends.
+  void startScalingBenchmark(std::vector<ScalingBenchmark::Step> steps)
+  {
+    m_swapModeBeforeBenchmark = m_framePacer.mode();
+    m_framePacer.setMode(FramePacer::eUncapped);
+    m_benchmark.start(std::move(steps));
+  }
+
+  // Scan or compaction throughput by implementation and element count, on its own submissions
+  void startScanBenchmark()
+  {
+    const bool               subgroup = ScanPass::isSubgroupSupported(m_physicalDevice);
+    const bool               lookBack = ScanPass::isLookBackSupported(m_physicalDevice);
+    std::vector<std::string> variants;
+    m_scanVariants.clear();
+    for(ScanSettings::Algorithm algorithm : {ScanSettings::eReduceThenScan, ScanSettings::eLookBack})
+    {
+      if(algorithm == ScanSettings::eLookBack && !lookBack)
+        continue;
+      const char* name = algorithm == ScanSettings::eLookBack ? "look-back" : "3 passes";
+      variants.push_back(std::string("Shared, ") + name);
+      m_scanVariants.push_back({.algorithm = algorithm, .subgroup = false});
+      if(subgroup)
+      {
+        variants.push_back(std::string("Subgroup, ") + name);
+        m_scanVariants.push_back({.algorithm = algorithm, .subgroup = true});
+      }
+    }
+    if(!m_scanWorkload.isValid())
+      m_scanWorkload.init(m_device, m_physicalDevice, m_pipelineCache, m_alloc, m_queueIdxCompute);
+    m_scanBenchmark.start(variants, {1u << 16, 1u << 18, 1u << 20, 1u << 22, ScanBenchmarkVk::kMaxCount});
+  }
+
+  // Time spent before the first frame, and the compute pipelines created meanwhile
+  void logStartupReport(double deviceMs, double prepareMs) const
+  {
+    LOGI("Startup: %.1f ms for the window and device, %.1f ms to prepare the producers\n", deviceMs, prepareMs);
+    if(!m_computeFeatures.pipelineFeedback)
+    {
+      LOGI("  Pipeline creation feedback not available\n");
+      return;
+    }
+    for(const PipelineCreationStats::Record& r : m_pipelineStats.records)
+      LOGI("  Pipeline %s: %.3f ms%s\n", r.name, r.ms, r.cacheHit ? ", pipeline cache hit" : "");
+    LOGI("  %u pipeline(s): %.3f ms, %u pipeline cache hit(s)\n", m_pipelineStats.count(), m_pipelineStats.totalMs(),
+         m_pipelineStats.cacheHits());
+  }
+
+  static std::string shaderObjectCachePath() { return NVPSystem::exePath() + PROJECT_NAME "_shader_objects.bin"; }
+  static std::string pipelineCachePath() { return NVPSystem::exePath() + PROJECT_NAME "_pipeline_cache.bin"; }
+
+  // Round-robin distribution of the producers over the active queues
+  uint32_t producerQueue(uint32_t producerIndex) const
+  {
+    return m_computeQueues[producerIndex % m_activeQueues];
+  }
+
+  void setQueueCount(uint32_t count)
+  {
+    if(count == m_activeQueues)
+      return;
+    m_activeQueues = count;
+    for(uint32_t i = 0; i < uint32_t(m_producers.size()); i++)
+      m_producers[i]->setQueue(producerQueue(i));
+  }
+
+  // Variation of the kernel parameters, so that each producer can be told apart in the grid
+  static KernelParams makeProducerParams(uint32_t index)
+  {
+    KernelParams params;
+    if(index == 0)
+      return params;
+    const float golden = 2.39996323f;  // Golden angle, spreads the hues evenly
+    params.hue         = float(index) * golden;
+    params.speed       = 0.3f + 0.1f * float(index % 5);
+    params.scale       = 3.0f + float(index % 4);
+    params.center[0]   = 0.5f + 0.2f * sinf(float(index) * golden);
+    params.center[1]   = 0.5f + 0.2f * cosf(float(index) * golden);
+    return params;
+  }
+
   //--------------------------------------------------------------------------------------------------
   //
   //
@@ -153,51 +489,546 @@ public:
       }
     }
 
+    // The blur benchmark drives the blur settings
+    if(m_blurBenchmark.isRunning())
+      setBlur(blurBenchmarkSettings(m_blurBenchmark.current()));
+
+    // The HDR benchmark drives the format, the tone mapping and the image size
+    if(m_hdrBenchmark.isRunning())
+      applyHdrBenchmarkStep(m_hdrBenchmark.current());
+
+    // The scan benchmark runs next to the producers
+    if(m_scanBenchmark.isRunning())
+    {
+      const GpuPassBenchmark::Step& step = m_scanBenchmark.current();
+      if(m_scanWorkload.count() != step.param)
+        m_scanWorkload.resize(step.param);
+      m_scanWorkload.run(m_scanVariants[step.variant], m_scanCompact);
+    }
+
+    // The benchmark drives the number of producers
+    if(m_benchmark.isRunning())
+    {
+      setQueueCount(m_benchmark.current().queues);
+      setProducerCount(m_benchmark.current().producers);
+    }
+
+    const uint32_t producerCount = uint32_t(m_producers.size());
+    const double   framePixels   = double(producerCount) * double(m_textureSize.width) * double(m_textureSize.height);
+
     // Input GUI
     ImGui::NewFrame();
     ImGui::SetNextWindowSize(ImGuiH::dpiScaled(350, 0), ImGuiCond_FirstUseEver);
     if(ImGui::Begin("gl_vk_simple_interop"))
     {
       ImGui::Text("FPS: %.3f", fps);
+      ImGui::Checkbox("Animate", &m_animate);
+      ImGui::SameLine();
+      ImGui::Checkbox("Throttle when unfocused", &m_throttleUnfocused);
+      // Shaders are embedded in the executable; this reloads the .spv files of the producers from disk
+      if(ImGui::Button("Reload shaders"))
+      {
+        for(auto& producer : m_producers)
+          producer->reloadShaders();
+      }
+      // The bindless table replaces the descriptors of each producer, push descriptors included
+      ImGui::BeginDisabled(!m_deviceFeatures.bindless);
+      if(ImGui::Checkbox("Bindless images", &m_computeFeatures.bindless))
+        recreateProducers();
+      ImGui::EndDisabled();
+      ImGui::SameLine();
+      ImGui::BeginDisabled(!m_deviceFeatures.pushDescriptor || m_computeFeatures.bindless);
+      if(ImGui::Checkbox("Push descriptors", &m_computeFeatures.pushDescriptor))
+        recreateProducers();
+      ImGui::EndDisabled();
+      ImGui::SameLine();
+      ImGui::BeginDisabled(!m_deviceFeatures.shaderObject);
+      if(ImGui::Checkbox("Shader objects", &m_computeFeatures.shaderObject))
+        recreateProducers();
+      ImGui::EndDisabled();
+
+      // Kernel switching, among the variants usable with the current settings
+      if(ImGui::BeginCombo("Kernel", m_kernelVariant ? m_kernelVariant->shader.filename : "Auto"))
+      {
+        if(ImGui::Selectable("Auto", m_kernelVariant == nullptr))
+          setKernelVariant(nullptr);
+        for(const ComputeShaderVariant& variant : shader_comp_variants)
+        {
+          if(variant.format != textureFormat() || variant.bindless != m_computeFeatures.bindless
+             || !isShaderVariantSupported(m_physicalDevice, variant))
+            continue;
+          if(ImGui::Selectable(variant.shader.filename, &variant == m_kernelVariant))
+            setKernelVariant(&variant);
+        }
+        ImGui::EndCombo();
+      }
+      ImGui::Text("Last kernel switch: %.3f ms (%s)", m_kernelSwitchMs,
+                  m_computeFeatures.shaderObject ? "shader objects" : "pipelines");
+      if(m_computeFeatures.pipelineFeedback)
+        ImGui::Text("Pipelines: %u created in %.3f ms, %u cache hits", m_pipelineStats.count(),
+                    m_pipelineStats.totalMs(), m_pipelineStats.cacheHits());
+      if(m_computeFeatures.shaderObject)
+        ImGui::Text("Shader binaries: %zu cached, %u hits, %u compiled", m_shaderObjectCache.size(),
+                    m_shaderObjectCache.hits(), m_shaderObjectCache.misses());
+
+      // Ping-pong: shaders/diffusion.comp iterated on a pair of images, each reading the previous one
+      ImGui::BeginDisabled(m_useSparse || isHdrInUse());
+      if(ImGui::SliderInt("Ping-pong iterations", &m_pingPongIterations, 0, 32, m_pingPongIterations == 0 ? "off" : "%d"))
+      {
+        for(auto& producer : m_producers)
+          producer->setIterations(uint32_t(m_pingPongIterations));
+      }
+      ImGui::EndDisabled();
+
+      // Blur after the kernel, see BlurPass
+      ImGui::BeginDisabled(m_blurBenchmark.isRunning() || isHdrInUse() || !isWholeImageReadAllowed());
+      BlurSettings   blur      = m_blurSettings;
+      const uint32_t maxRadius = blur.mode == BlurSettings::eFft ? FftConvolutionPass::kMaxRadius : BlurPass::kMaxRadius;
+      int            radius    = int(std::min(blur.radius, maxRadius));
+      ImGui::SliderInt("Blur radius", &radius, 0, int(maxRadius), radius == 0 ? "off" : "%d");
+      blur.radius  = uint32_t(radius);
+      int blurMode = blur.mode;
+      ImGui::Combo("Blur mode", &blurMode, "Separable\0Naive 2D\0FFT\0");
+      blur.mode = BlurSettings::Mode(blurMode);
+      if(blur.mode == BlurSettings::eFft && !FftConvolutionPass::isSupported(m_physicalDevice))
+        ImGui::Text("Not enough shared memory for the FFT, the separable blur is used");
+      else if(blur.mode == BlurSettings::eFft
+              && !FftConvolutionPass::fits(m_physicalDevice, m_producers[0]->m_tiles[0]->m_textureTarget.imgSize, blur.radius))
+        ImGui::Text("The tiles are too large for an FFT of this radius, they are not blurred");
+      ImGui::Checkbox("Gaussian", &blur.gaussian);
+      ImGui::SameLine();
+      ImGui::BeginDisabled(!BlurPass::isFp16Supported(m_physicalDevice) || blur.mode != BlurSettings::eSeparable);
+      ImGui::Checkbox("FP16 accumulation", &blur.fp16);
+      ImGui::EndDisabled();
+      if(!(blur == m_blurSettings))
+      {
+        m_blurSettings = blur;
+        setBlur(blur);
+      }
+      if(ImGui::Button("Run blur benchmark"))
+        startBlurBenchmark();
+      ImGui::EndDisabled();
+      if(m_blurBenchmark.isRunning())
+      {
+        ImGui::SameLine();
+        ImGui::ProgressBar(m_blurBenchmark.progress());
+      }
+      else if(!m_blurBenchmark.results().empty() && ImGui::TreeNode("Blur benchmark results"))
+      {
+        for(const auto& r : m_blurBenchmark.results())
+        {
+          if(r.gpuMs >= 0.0)
+            ImGui::Text("Radius %3u, %s: %.3f ms", r.step.param, m_blurBenchmark.variants()[r.step.variant].c_str(), r.gpuMs);
+        }
+        ImGui::TreePop();
+      }
+      const double blurMs = m_producers[0]->m_tiles[0]->blurGpuMs();
+      if(m_blurSettings.radius > 0 && blurMs >= 0.0)
+        ImGui::Text("Blur: %.3f ms (GPU, first tile)", blurMs);
+
+      // Exposure computed on the GPU and read by OpenGL, see ExposurePass
+      ExposureSettings exposure = m_exposureSettings;
+      ImGui::BeginDisabled(!isWholeImageReadAllowed());
+      ImGui::Checkbox("Auto exposure", &exposure.enabled);
+      ImGui::EndDisabled();
+      ImGui::SameLine();
+      ImGui::TextUnformatted(ExposurePass::isSubgroupSupported(m_physicalDevice) ? "(subgroup histogram)" : "(shared memory histogram)");
+      ImGui::BeginDisabled(!exposure.enabled);
+      ImGui::SliderFloat("Exposure key", &exposure.key, 0.05f, 1.0f);
+      ImGui::SliderFloat("Adaptation speed", &exposure.adaptationSpeed, 0.1f, 10.0f, "%.1f /s", ImGuiSliderFlags_Logarithmic);
+      ImGui::EndDisabled();
+      if(!(exposure == m_exposureSettings))
+      {
+        m_exposureSettings = exposure;
+        for(auto& producer : m_producers)
+          producer->setExposure(exposure);
+      }
+
+      // HDR: RGBA16F images, tone mapped by OpenGL when displayed or by a compute pass, see ToneMapPass
+      ImGui::BeginDisabled(m_hdrBenchmark.isRunning());
+      ImGui::BeginDisabled(!m_hdr && !isHdrAvailable());
+      if(ImGui::Checkbox("HDR (RGBA16F)", &m_hdr))
+        setHdr(m_hdr);
+      ImGui::EndDisabled();
+      ImGui::BeginDisabled(!m_hdr);
+      ToneMapSettings toneMapping = m_toneMapSettings;
+      int             op          = toneMapping.op;
+      int             location    = toneMapping.location;
+      ImGui::Combo("Tone mapping", &op, "Clamp\0Reinhard\0ACES\0Hable\0");
+      ImGui::Combo("Tone map in", &location, "Present shader (OpenGL)\0Compute pass (Vulkan)\0");
+      ImGui::SliderFloat("White point", &toneMapping.whitePoint, 1.0f, 16.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+      toneMapping.op       = ToneMapSettings::Operator(op);
+      toneMapping.location = ToneMapSettings::Location(location);
+      if(!(toneMapping == m_toneMapSettings))
+      {
+        m_toneMapSettings = toneMapping;
+        setToneMapping(toneMapping);
+      }
+      ImGui::EndDisabled();
+      ImGui::BeginDisabled(!isHdrAvailable());
+      if(ImGui::Button("Run HDR benchmark"))
+        startHdrBenchmark();
+      ImGui::EndDisabled();
+      ImGui::EndDisabled();
+      if(m_hdrBenchmark.isRunning())
+      {
+        ImGui::SameLine();
+        ImGui::ProgressBar(m_hdrBenchmark.progress());
+      }
+      else if(!m_hdrBenchmark.results().empty() && ImGui::TreeNode("HDR benchmark results"))
+      {
+        for(const auto& r : m_hdrBenchmark.results())
+          ImGui::Text("%4u^2, %s: %.3f ms", r.step.param, m_hdrBenchmark.variants()[r.step.variant].c_str(), r.gpuMs);
+        ImGui::TreePop();
+      }
+      const double presentMs = m_presentTimer.lastMs();
+      const double computeMs = m_producers[0]->m_tiles[0]->computeGpuMs();
+      if(presentMs >= 0.0 && computeMs >= 0.0)
+        ImGui::Text("GPU: kernel %.3f ms (first tile), present %.3f ms", computeMs, presentMs);
+
+      // BC compression of the images, OpenGL samples the compressed ones, see BlockCompressPass
+      ImGui::BeginDisabled(!BlockCompressPass::isSupported(m_physicalDevice) || isHdrInUse() || !isWholeImageReadAllowed());
+      BlockCompressSettings compression = m_compressSettings;
+      int                   format      = compression.format;
+      int                   preset      = compression.preset;
+      ImGui::Combo("Block compression", &format, "Off\0BC1 (RGB)\0BC4 (luminance)\0BC7 (RGBA)\0");
+      ImGui::Combo("Compression preset", &preset, "Fast\0Quality\0");
+      compression.format = BlockCompressSettings::Format(format);
+      compression.preset = BlockCompressSettings::Preset(preset);
+      if(!(compression == m_compressSettings))
+      {
+        m_compressSettings = compression;
+        for(auto& producer : m_producers)
+          producer->setBlockCompression(compression);
+      }
+      ImGui::EndDisabled();
+      const ComputeImageVk& firstTile  = *m_producers[0]->m_tiles[0];
+      const double          compressMs = firstTile.compressGpuMs();
+      if(firstTile.isCompressed() && compressMs >= 0.0)
+        ImGui::Text("Compression: %.3f ms (GPU, first tile), %.1f MB instead of %.1f MB", compressMs,
+                    double(firstTile.m_compress.compressedBytes()) / (1024.0 * 1024.0),
+                    double(firstTile.m_compress.sourceBytes()) / (1024.0 * 1024.0));
+
+      // Signed distance field of the bright parts of the images, outlined here, see SdfPass
+      SdfSettings sdf = m_sdfSettings;
+      ImGui::BeginDisabled(!isWholeImageReadAllowed());
+      ImGui::Checkbox("Distance field outline", &sdf.enabled);
+      ImGui::EndDisabled();
+      ImGui::BeginDisabled(!sdf.enabled);
+      ImGui::SliderFloat("Outline threshold", &sdf.threshold, 0.0f, 1.0f, "%.2f");
+      ImGui::SliderFloat("Outline width", &sdf.outlineWidth, 0.5f, 16.0f, "%.1f px", ImGuiSliderFlags_Logarithmic);
+      ImGui::EndDisabled();
+      if(!(sdf == m_sdfSettings))
+      {
+        m_sdfSettings = sdf;
+        for(auto& producer : m_producers)
+          producer->setSdf(sdf);
+      }
+      const double sdfMs = firstTile.sdfGpuMs();
+      if(sdfMs >= 0.0)
+        ImGui::Text("Distance field: %u passes, %.3f ms (GPU, first tile)", firstTile.sdfPasses(), sdfMs);
+
+      // Vsync clamps the measurements to the display refresh, the scaling benchmark runs uncapped
+      ImGui::BeginDisabled(m_benchmark.isRunning());
+      int swapMode = m_framePacer.mode();
+      if(ImGui::Combo("Swap mode", &swapMode, m_framePacer.adaptiveSupported() ?
+                                                  "Vsync\0Uncapped\0Adaptive vsync\0Frame limiter\0" :
+                                                  "Vsync\0Uncapped\0Adaptive vsync (unsupported)\0Frame limiter\0"))
+        m_framePacer.setMode(FramePacer::SwapMode(swapMode));
+      ImGui::EndDisabled();
+      if(m_framePacer.mode() == FramePacer::eLimited)
+        ImGui::SliderInt("Target FPS", &m_framePacer.m_limiterFps, 10, 1000, "%d", ImGuiSliderFlags_Logarithmic);
+      ImGui::SliderInt("Max queued frames", &m_framePacer.m_maxQueuedFrames, 0, 4,
+                       m_framePacer.m_maxQueuedFrames == 0 ? "unbounded" : "%d");
+      ImGui::Text("Throughput: %.3f Gpixels/s", framePixels * fps * 1e-9);
+
+      ImGui::BeginDisabled(m_benchmark.isRunning());
+      int numProducers = int(producerCount);
+      if(ImGui::SliderInt("Producers", &numProducers, 1, int(MAX_PRODUCERS)))
+        setProducerCount(uint32_t(numProducers));
+      int numQueues = int(m_activeQueues);
+      if(ImGui::SliderInt("Compute queues", &numQueues, 1, int(m_computeQueues.size())))
+        setQueueCount(uint32_t(numQueues));
+      if(ImGui::Button("Run scaling benchmark"))
+        startScalingBenchmark(ScalingBenchmark::producerSweep(MAX_PRODUCERS));
+      ImGui::SameLine();
+      if(ImGui::Button("Run queue benchmark"))
+        startScalingBenchmark(ScalingBenchmark::queueSweep(MAX_PRODUCERS, uint32_t(m_computeQueues.size())));
+      ImGui::EndDisabled();
+      if(m_benchmark.isRunning())
+      {
+        ImGui::SameLine();
+        ImGui::ProgressBar(m_benchmark.progress());
+      }
+      else if(!m_benchmark.results().empty() && ImGui::TreeNode("Benchmark results"))
+      {
+        for(const auto& r : m_benchmark.results())
+          ImGui::Text("%2u producers, %u queues: %.3f Gpixels/s (%.3f ms)", r.step.producers, r.step.queues,
+                      r.gpixelsPerSecond, r.msPerFrame);
+        ImGui::TreePop();
+      }
 
-      int textureWidth  = int(m_compute.m_textureTarget.imgSize.width);
-      int textureHeight = int(m_compute.m_textureTarget.imgSize.height);
+      // Heightfield, normals and patches generated by Vulkan and drawn by OpenGL, see TerrainVk
+      TerrainSettings terrain    = m_terrainSettings;
+      int             resolution = 0;
+      while((256u << resolution) < terrain.resolution)
+        resolution++;
+      ImGui::BeginDisabled(m_volumeSettings.enabled);
+      ImGui::Checkbox("Terrain", &terrain.enabled);
+      ImGui::EndDisabled();
+      ImGui::BeginDisabled(!terrain.enabled);
+      ImGui::Combo("Terrain resolution", &resolution, "256\0" "512\0" "1024\0" "2048\0" "4096\0");
+      terrain.resolution = 256u << resolution;
+      ImGui::SliderFloat("Terrain height", &terrain.heightScale, 0.0f, 0.5f, "%.2f");
+      ImGui::SliderFloat("Pixels per edge", &terrain.pixelsPerEdge, 2.0f, 64.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+      ImGui::Checkbox("Wireframe", &terrain.wireframe);
+      ImGui::EndDisabled();
+      if(!(terrain == m_terrainSettings))
+        setTerrain(terrain);
+      const double terrainMs = m_terrain.isValid() ? m_terrain.lastGpuMs() : -1.0;
+      if(m_terrainSettings.enabled && terrainMs >= 0.0)
+        ImGui::Text("Terrain: %u patches, generated in %.3f ms (GPU), drawn in %.3f ms", m_terrain.patchCount(),
+                    terrainMs, m_presentTimer.lastMs());
+
+      // 3D density computed by Vulkan in bricks and ray-marched by OpenGL, see VolumeVk
+      VolumeSettings volume           = m_volumeSettings;
+      int            volumeResolution = 0;
+      while((64u << volumeResolution) < volume.resolution)
+        volumeResolution++;
+      ImGui::BeginDisabled(m_terrainSettings.enabled);
+      ImGui::Checkbox("Volume", &volume.enabled);
+      ImGui::EndDisabled();
+      ImGui::BeginDisabled(!volume.enabled);
+      ImGui::Combo("Volume resolution", &volumeResolution, "64^3\0" "128^3\0" "256^3\0" "512^3\0");
+      volume.resolution = 64u << volumeResolution;
+      ImGui::SliderFloat("Bricks per frame", &volume.updateFraction, 0.01f, 1.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+      ImGui::SliderFloat("Density threshold", &volume.threshold, 0.0f, 0.5f, "%.2f");
+      ImGui::SliderFloat("Density scale", &volume.densityScale, 1.0f, 200.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+      ImGui::Checkbox("Empty-space skipping", &volume.skipEmpty);
+      ImGui::SameLine();
+      ImGui::Checkbox("Show steps", &volume.showSteps);
+      ImGui::EndDisabled();
+      if(!(volume == m_volumeSettings))
+        setVolume(volume);
+      const double volumeMs = m_volume.isValid() ? m_volume.lastGpuMs() : -1.0;
+      if(m_volumeSettings.enabled && volumeMs >= 0.0)
+        ImGui::Text("Volume: %u of %u bricks computed in %.3f ms (GPU), ray-marched in %.3f ms", m_volume.lastBrickCount(),
+                    m_volume.brickCount(), volumeMs, m_presentTimer.lastMs());
+
+      // Prefix sum or stream compaction of interop buffers, see ScanPass
+      ImGui::BeginDisabled(m_scanBenchmark.isRunning());
+      ImGui::Checkbox("Compaction", &m_scanCompact);
+      ImGui::SameLine();
+      if(ImGui::Button(m_scanCompact ? "Run compaction benchmark" : "Run scan benchmark"))
+        startScanBenchmark();
+      ImGui::EndDisabled();
+      if(m_scanBenchmark.isRunning())
+      {
+        ImGui::SameLine();
+        ImGui::ProgressBar(m_scanBenchmark.progress());
+      }
+      else if(!m_scanBenchmark.results().empty() && ImGui::TreeNode("Scan benchmark results"))
+      {
+        for(const auto& r : m_scanBenchmark.results())
+          ImGui::Text("%8u elements, %s: %.3f ms, %.2f Gelements/s", r.step.param,
+                      m_scanBenchmark.variants()[r.step.variant].c_str(), r.gpuMs, double(r.step.param) / r.gpuMs * 1e-6);
+        ImGui::TreePop();
+      }
+
+      int textureWidth  = int(m_textureSize.width);
+      int textureHeight = int(m_textureSize.height);
       // The slider max of 16384 here is somewhat arbitrary; Ctrl-click to set
       // it to a larger value. It's set to 16K so that casually sliding the
       // sliders won't run out of memory on most GPUs.
-      // Use glGetIntegerv(GL_MAX_TEXTURE_SIZE) to get the maximum texture size.
+      // Sizes above the device limits are split into tiles, see TiledImageVk.
       ImGui::SliderInt("Texture Width", &textureWidth, 1, 16384, "%d", ImGuiSliderFlags_Logarithmic);
       ImGui::SliderInt("Texture Height", &textureHeight, 1, 16384, "%d", ImGuiSliderFlags_Logarithmic);
+      const int deviceMaxTile = int(m_producers[0]->deviceMaxTileDimension());
+      int       maxTile       = m_maxTileDimension == 0 ? deviceMaxTile : int(m_maxTileDimension);
+      if(ImGui::SliderInt("Max Tile Size", &maxTile, 64, deviceMaxTile, "%d", ImGuiSliderFlags_Logarithmic))
+      {
+        m_maxTileDimension = uint32_t(maxTile);
+        for(auto& producer : m_producers)
+          producer->setMaxTileDimension(m_maxTileDimension);
+      }
+      if(m_producers[0]->isTiled())
+        ImGui::Text("Tiles: %u x %u of %u x %u", m_producers[0]->m_columns, m_producers[0]->m_rows,
+                    m_producers[0]->m_tileSize.width, m_producers[0]->m_tileSize.height);
+
+      // Zooming in shrinks the visible region: only that region is computed (and resident if sparse)
+      ImGui::SliderFloat("Zoom", &m_viewZoom, 1.f, 256.f, "%.2f", ImGuiSliderFlags_Logarithmic);
+      ImGui::SliderFloat2("Pan", m_viewCenter, 0.f, 1.f);
+      const bool sparseReadsUndefined = !m_sparseSupport.nonResidentStrict && readsWholeImages();
+      ImGui::BeginDisabled(!m_sparseSupport.supported || m_pingPongIterations > 0 || isHdrInUse() || sparseReadsUndefined);
+      if(ImGui::Checkbox("Sparse residency", &m_useSparse))
+      {
+        for(auto& producer : m_producers)
+          producer->setSparse(m_useSparse ? &m_sparseSupport : nullptr);
+      }
+      ImGui::EndDisabled();
+      if(!m_sparseSupport.supported)
+        ImGui::TextWrapped("Sparse residency unavailable: %s", m_sparseSupport.reason.c_str());
+      else if(sparseReadsUndefined && !m_useSparse)
+        ImGui::TextWrapped("Sparse residency unavailable with blur, exposure, compression or distance field: "
+                           "the device does not guarantee what non-resident pages read");
+      else if(m_useSparse)
+      {
+        VkDeviceSize resident = 0, full = 0;
+        for(const auto& producer : m_producers)
+          for(const auto& tile : producer->m_tiles)
+          {
+            resident += tile->m_sparseTexture.residentBytes();
+            full += tile->m_sparseTexture.fullBytes();
+          }
+        ImGui::Text("Resident: %.1f MB of %.1f MB", double(resident) / (1024.0 * 1024.0), double(full) / (1024.0 * 1024.0));
+      }
       const VkExtent2D newSize = {uint32_t(textureWidth), uint32_t(textureHeight)};
       // Did the size change?
-      if(0 != memcmp(&newSize, &m_compute.m_textureTarget.imgSize, sizeof(VkExtent2D)))
+      if(0 != memcmp(&newSize, &m_textureSize, sizeof(VkExtent2D)))
       {
-        // Recreate the interop texture:
-        m_compute.update(newSize);
+        // Recreate the interop textures:
+        m_textureSize = newSize;
+        for(auto& producer : m_producers)
+          producer->update(newSize);
       }
     }
     ImGui::End();
 
-    glViewport(0, 0, m_size.width, m_size.height);
-
-    // Signal Vulkan it can use the texture
-    GLenum dstLayout = GL_LAYOUT_SHADER_READ_ONLY_EXT;
-    glSignalSemaphoreEXT(m_compute.m_semaphores.glReady, 0, nullptr, 1, &m_compute.m_textureTarget.oglId, &dstLayout);
-
-    // Invoke Vulkan
-    m_compute.buildCommandBuffers();
-    m_compute.submit();
-
-    // Wait (on the GPU side) for the Vulkan semaphore to be signaled (finished compute)
-    GLenum srcLayout = GL_LAYOUT_COLOR_ATTACHMENT_EXT;
-    glWaitSemaphoreEXT(m_compute.m_semaphores.glComplete, 0, nullptr, 1, &m_compute.m_textureTarget.oglId, &srcLayout);
+    // Part of the logical images shown by the view
+    const std::array<float, 4> viewRect = {m_viewCenter[0] - 0.5f / m_viewZoom, m_viewCenter[1] - 0.5f / m_viewZoom,
+                                           1.f / m_viewZoom, 1.f / m_viewZoom};
+    for(auto& producer : m_producers)
+      producer->setVisibleRegion(viewRect);
+
+    // Gather the interop resources of each submission, the shared vertex buffer goes with the first
+    m_interop.beginFrame();
+    for(auto& producer : m_producers)
+      for(auto& tile : producer->m_tiles)
+        tile->registerInterop(m_interop);
+    const ComputeImageVk::Semaphores& first = m_producers[0]->m_tiles[0]->m_semaphores;
+    m_interop.batch(first.glReady, first.glComplete).addBuffer(m_bufferVk.oglId);
+    if(m_terrainSettings.enabled)
+      m_terrain.registerInterop(m_interop);
+    if(m_volumeSettings.enabled)
+      m_volume.registerInterop(m_interop);
+
+    // Signal Vulkan it can use the resources
+    m_interop.signalAll();
+
+    // Invoke Vulkan: all producers are submitted before OpenGL waits on any of them
+    for(auto& producer : m_producers)
+    {
+      for(auto& tile : producer->m_tiles)
+      {
+        tile->buildCommandBuffers(m_animationTime);
+        tile->submit();
+      }
+    }
+    if(m_terrainSettings.enabled)
+    {
+      m_terrain.buildCommandBuffer(m_animationTime, m_terrainSettings);
+      m_terrain.submit();
+    }
+    if(m_volumeSettings.enabled)
+    {
+      m_volume.buildCommandBuffer(m_animationTime, m_volumeSettings);
+      m_volume.submit();
+    }
 
-    // Issue OpenGL commands to draw a triangle using this texture
+    // Wait (on the GPU side) for the Vulkan semaphores to be signaled (finished compute)
+    m_interop.waitAll();
+
+    // Issue OpenGL commands to draw a triangle per producer, laid out in a grid, or the terrain or
+    // the volume instead while the producers keep computing
+    const uint32_t drawnProducers = (m_terrainSettings.enabled || m_volumeSettings.enabled) ? 0 : producerCount;
+    const uint32_t columns        = uint32_t(ceilf(sqrtf(float(producerCount))));
+    const uint32_t rows           = (producerCount + columns - 1) / columns;
+    const int      cellW          = m_size.width / int(columns);
+    const int      cellH          = m_size.height / int(rows);
+    m_presentTimer.begin();
     glBindVertexArray(m_vertexArray);
-    glBindTextureUnit(0, m_compute.m_textureTarget.oglId);
     glUseProgram(m_programID);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glProgramUniform4f(m_programID, m_viewRectLocation, viewRect[0], viewRect[1], viewRect[2], viewRect[3]);
+    glProgramUniform1f(m_programID, m_whitePointLocation, m_toneMapSettings.whitePoint);
+    glProgramUniform1f(m_programID, m_outlineWidthLocation, m_sdfSettings.outlineWidth);
+    for(uint32_t i = 0; i < drawnProducers; i++)
+    {
+      glViewport(int(i % columns) * cellW, int(rows - 1 - i / columns) * cellH, cellW, cellH);
+      // Each tile only shades the fragments whose UV falls in its own region
+      const TiledImageVk& producer = *m_producers[i];
+      for(uint32_t t = 0; t < uint32_t(producer.m_tiles.size()); t++)
+      {
+        const std::array<float, 4> rect = producer.tileRect(t);
+        glProgramUniform4f(m_programID, m_tileRectLocation, rect[0], rect[1], rect[2], rect[3]);
+        glBindTextureUnit(0, producer.m_tiles[t]->displayTexture());
+        // Each tile has its own exposure
+        const GLuint exposureBuffer = producer.m_tiles[t]->exposureBuffer();
+        glProgramUniform1i(m_programID, m_autoExposureLocation, exposureBuffer != 0);
+        if(exposureBuffer != 0)
+          glBindBufferBase(GL_UNIFORM_BUFFER, 0, exposureBuffer);
+        // HDR tiles tone mapped by a compute pass are displayed as they are
+        const int toneMapOperator = producer.m_tiles[t]->displayToneMaps() ? int(m_toneMapSettings.op) : -1;
+        glProgramUniform1i(m_programID, m_toneMapOperatorLocation, toneMapOperator);
+        const GLuint sdfTexture = producer.m_tiles[t]->sdfTexture();
+        glProgramUniform1i(m_programID, m_sdfOutlineLocation, sdfTexture != 0);
+        glBindTextureUnit(1, sdfTexture);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+      }
+    }
     glBindTextureUnit(0, 0);
+    glBindTextureUnit(1, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, 0);
+    glViewport(0, 0, m_size.width, m_size.height);
+    if(m_terrainSettings.enabled)
+      drawTerrain();
+    if(m_volumeSettings.enabled)
+      drawVolume();
+    m_presentTimer.end();
+
+    const bool scaling = m_benchmark.isRunning();
+    m_benchmark.frame(framePixels);
+    if(scaling && !m_benchmark.isRunning())
+      m_framePacer.setMode(m_swapModeBeforeBenchmark);
+    if(m_blurBenchmark.isRunning())
+    {
+      m_blurBenchmark.frame(m_producers[0]->m_tiles[0]->blurGpuMs());
+      if(!m_blurBenchmark.isRunning())
+      {
+        m_blurBenchmark.report("Blur benchmark, GPU time of the first tile", "radius");
+        for(uint32_t spatial : {0u, 1u})
+        {
+          const uint32_t radius = m_blurBenchmark.crossover(2, spatial);
+          if(radius != 0)
+            LOGI("FFT is faster than %s from radius %u\n", m_blurBenchmark.variants()[spatial].c_str(), radius);
+          else
+            LOGI("FFT is not faster than %s at the radii measured\n", m_blurBenchmark.variants()[spatial].c_str());
+        }
+        setBlur(m_blurSettings);
+      }
+    }
+    if(m_hdrBenchmark.isRunning())
+    {
+      m_hdrBenchmark.frame(frameGpuMs());
+      if(!m_hdrBenchmark.isRunning())
+      {
+        m_hdrBenchmark.report("HDR benchmark, GPU time of the kernels and the present pass", "size");
+        setHdr(m_hdr);
+        setToneMapping(m_toneMapSettings);
+        for(auto& producer : m_producers)
+          producer->update(m_textureSize);
+      }
+    }
+    if(m_scanBenchmark.isRunning())
+    {
+      m_scanBenchmark.frame(m_scanWorkload.lastGpuMs());
+      if(!m_scanBenchmark.isRunning())
+      {
+        m_scanBenchmark.report(m_scanCompact ? "Compaction benchmark, GPU time" : "Scan benchmark, GPU time", "elements");
+        if(m_scanWorkload.failedChecks() > 0)
+          LOGE("Scan benchmark: %u configurations gave wrong results, see above\n", m_scanWorkload.failedChecks());
+        m_scanWorkload.deinit();
+      }
+    }
 
     // Draw GUI
     ImGui::Render();
@@ -210,9 +1041,14 @@ public:
   //
   void animate()
   {
-    static auto startTime   = std::chrono::high_resolution_clock::now();
-    auto        currentTime = std::chrono::high_resolution_clock::now();
-    float       t           = std::chrono::duration<float>(currentTime - startTime).count() * 0.5f;
+    // The animation clock only advances while animating
+    auto  now       = std::chrono::high_resolution_clock::now();
+    float dt        = std::chrono::duration<float>(now - m_lastFrameTime).count();
+    m_lastFrameTime = now;
+    if(isAnimating())
+      m_animationTime += dt;
+
+    float t = m_animationTime * 0.5f;
     // Modify the buffer and upload it in the Vulkan allocated buffer
     g_vertexDataVK[0].pos.x = sinf(t);
     g_vertexDataVK[1].pos.y = cosf(t);
@@ -260,10 +1096,66 @@ public:
       layout(location = 0) out vec4 fragColor;
             
       uniform sampler2D myTextureSampler;
+      uniform vec4      tileRect;  // UV region of the logical image held by the texture
+      uniform vec4      viewRect;  // UV region of the logical image shown by the view
+      uniform int       autoExposure;
+      uniform int       toneMapOperator;  // ToneMapSettings::Operator, -1 to display as is
+      uniform float     whitePoint;
+      uniform sampler2D sdfSampler;    // Signed distance in pixels of the texture, see SdfPass
+      uniform int       sdfOutline;
+      uniform float     outlineWidth;  // In screen pixels
+
+      // Written by shaders/exposure.comp, see ExposureData
+      layout(std140, binding = 0) uniform Exposure
+      {
+        float exposure;
+        float averageLuminance;
+        float targetLuminance;
+      };
+
+      // Must match shaders/tonemap.comp
+      vec3 hable(vec3 x)
+      {
+        const float A = 0.15, B = 0.50, C = 0.10, D = 0.20, E = 0.02, F = 0.30;
+        return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+      }
+
+      vec3 toneMap(vec3 color)
+      {
+        switch(toneMapOperator)
+        {
+          case 0:
+            return min(color, vec3(1.0));
+          case 1:
+            return color * (1.0 + color / (whitePoint * whitePoint)) / (1.0 + color);
+          case 2:
+            return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+          case 3:
+            return hable(2.0 * color) / hable(vec3(whitePoint));
+          default:
+            return color;
+        }
+      }
 
       void main()
       {
-        vec3 color = texture( myTextureSampler, inUV ).rgb;
+        vec2 uv     = viewRect.xy + inUV * viewRect.zw;
+        vec2 tileUV = (uv - tileRect.xy) / tileRect.zw;
+        if(any(lessThan(tileUV, vec2(0))) || any(greaterThan(tileUV, vec2(1))))
+          discard;
+        vec3 color = texture( myTextureSampler, tileUV ).rgb;
+        if(autoExposure != 0)
+          color *= exposure;
+        color = toneMap(color);
+        if(sdfOutline != 0)
+        {
+          // The distance grows by one per texel: its derivative converts it to screen pixels, and
+          // the outline fades over one screen pixel on each side
+          float d        = texture(sdfSampler, tileUV).r;
+          float pixels   = abs(d) / max(fwidth(d), 1e-4);
+          float coverage = 1.0 - smoothstep(outlineWidth - 0.5, outlineWidth + 0.5, pixels);
+          color          = mix(color, vec3(1.0, 0.6, 0.1), coverage);
+        }
         fragColor = vec4(color,1);
       }
             
@@ -278,10 +1170,359 @@ public:
     glAttachShader(mSH2D, fs);
     glLinkProgram(mSH2D);
 
-    m_programID = mSH2D;
+    m_programID               = mSH2D;
+    m_tileRectLocation        = glGetUniformLocation(mSH2D, "tileRect");
+    m_viewRectLocation        = glGetUniformLocation(mSH2D, "viewRect");
+    m_autoExposureLocation    = glGetUniformLocation(mSH2D, "autoExposure");
+    m_toneMapOperatorLocation = glGetUniformLocation(mSH2D, "toneMapOperator");
+    m_whitePointLocation      = glGetUniformLocation(mSH2D, "whitePoint");
+    m_sdfOutlineLocation      = glGetUniformLocation(mSH2D, "sdfOutline");
+    m_outlineWidthLocation    = glGetUniformLocation(mSH2D, "outlineWidth");
+    glProgramUniform1i(mSH2D, glGetUniformLocation(mSH2D, "sdfSampler"), 1);
     return mSH2D;
   }
 
+  //--------------------------------------------------------------------------------------------------
+  // OpenGL program drawing the terrain of TerrainVk: each patch is a GL_PATCHES of one vertex, which
+  // the tessellation subdivides so that edges are about pixelsPerEdge long on screen. The levels of
+  // an edge only depend on its endpoints, so neighbor patches agree on them and there are no cracks.
+  //
+  void createTerrainProgram()
+  {
+    GLchar const* vss = {R"(
+      #version 450
+      layout(location = 0) in vec4 inPatch;  // u, v, minimum height, maximum height
+      out vec4 vPatch;
+
+      void main() { vPatch = inPatch; }
+    )"};
+
+    GLchar const* tcss = {R"(
+      #version 450
+      layout(vertices = 1) out;
+      in vec4  vPatch[];
+      out vec4 tcPatch[];
+
+      uniform mat4      viewProj;
+      uniform float     patchSize;  // In UV
+      uniform float     heightScale;
+      uniform vec2      viewportSize;
+      uniform float     pixelsPerEdge;
+      uniform sampler2D heightSampler;
+
+      vec3 worldPosition(vec2 uv, float height) { return vec3(uv.x - 0.5, height * heightScale, uv.y - 0.5); }
+
+      vec2 screenPosition(vec2 uv)
+      {
+        const vec4 clip = viewProj * vec4(worldPosition(uv, textureLod(heightSampler, uv, 0.0).r), 1.0);
+        return clip.xy / max(clip.w, 1e-3) * 0.5 * viewportSize;
+      }
+
+      float edgeLevel(vec2 a, vec2 b) { return clamp(distance(screenPosition(a), screenPosition(b)) / pixelsPerEdge, 1.0, 64.0); }
+
+      // Whether the bounding box of the patch is entirely outside one of the clip planes
+      bool outsideView(vec4 bounds)
+      {
+        ivec3 below = ivec3(0), above = ivec3(0);
+        for(int i = 0; i < 8; i++)
+        {
+          const vec2 uv   = bounds.xy + vec2(i & 1, (i >> 1) & 1) * patchSize;
+          const vec4 clip = viewProj * vec4(worldPosition(uv, (i & 4) != 0 ? bounds.w : bounds.z), 1.0);
+          below += ivec3(lessThan(clip.xyz, vec3(-clip.w)));
+          above += ivec3(greaterThan(clip.xyz, vec3(clip.w)));
+        }
+        return any(equal(below, ivec3(8))) || any(equal(above, ivec3(8)));
+      }
+
+      void main()
+      {
+        tcPatch[gl_InvocationID] = vPatch[gl_InvocationID];
+        const vec4 bounds        = vPatch[0];
+        if(outsideView(bounds))
+        {
+          gl_TessLevelOuter = float[4](0.0, 0.0, 0.0, 0.0);
+          gl_TessLevelInner = float[2](0.0, 0.0);
+          return;
+        }
+        const vec2 uv00      = bounds.xy;
+        const vec2 uv10      = bounds.xy + vec2(patchSize, 0.0);
+        const vec2 uv01      = bounds.xy + vec2(0.0, patchSize);
+        const vec2 uv11      = bounds.xy + vec2(patchSize);
+        gl_TessLevelOuter[0] = edgeLevel(uv00, uv01);
+        gl_TessLevelOuter[1] = edgeLevel(uv00, uv10);
+        gl_TessLevelOuter[2] = edgeLevel(uv10, uv11);
+        gl_TessLevelOuter[3] = edgeLevel(uv01, uv11);
+        gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+        gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+      }
+    )"};
+
+    GLchar const* tess = {R"(
+      #version 450
+      layout(quads, fractional_odd_spacing, ccw) in;
+      in vec4   tcPatch[];
+      out vec2  teUV;
+      out float teHeight;
+
+      uniform mat4      viewProj;
+      uniform float     patchSize;
+      uniform float     heightScale;
+      uniform sampler2D heightSampler;
+
+      void main()
+      {
+        teUV        = tcPatch[0].xy + gl_TessCoord.xy * patchSize;
+        teHeight    = textureLod(heightSampler, teUV, 0.0).r;
+        gl_Position = viewProj * vec4(teUV.x - 0.5, teHeight * heightScale, teUV.y - 0.5, 1.0);
+      }
+    )"};
+
+    GLchar const* fss = {R"(
+      #version 450
+      in vec2  teUV;
+      in float teHeight;
+      layout(location = 0) out vec4 fragColor;
+
+      uniform sampler2D normalSampler;
+
+      void main()
+      {
+        const vec3 normal = normalize(texture(normalSampler, teUV).xyz);
+        const vec3 light  = normalize(vec3(0.5, 0.8, 0.3));
+        // Grass, rock on the slopes, and snow on the flat summits
+        const float slope = 1.0 - normal.y;
+        vec3        color = mix(vec3(0.25, 0.45, 0.2), vec3(0.45, 0.4, 0.35), smoothstep(0.15, 0.35, slope));
+        color             = mix(color, vec3(0.95), smoothstep(0.7, 0.8, teHeight) * (1.0 - smoothstep(0.3, 0.5, slope)));
+        fragColor         = vec4(color * (0.25 + 0.75 * max(dot(normal, light), 0.0)), 1.0);
+      }
+    )"};
+
+    const GLenum        stages[4]  = {GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_FRAGMENT_SHADER};
+    const GLchar* const sources[4] = {vss, tcss, tess, fss};
+    m_terrainProgram               = glCreateProgram();
+    for(int i = 0; i < 4; i++)
+    {
+      GLuint shader = glCreateShader(stages[i]);
+      glShaderSource(shader, 1, &sources[i], nullptr);
+      glCompileShader(shader);
+      GLint compiled = GL_FALSE;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+      if(compiled != GL_TRUE)
+      {
+        char log[512];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        LOGE("Terrain shader: %s\n", log);
+      }
+      glAttachShader(m_terrainProgram, shader);
+      glDeleteShader(shader);
+    }
+    glLinkProgram(m_terrainProgram);
+    m_terrainLocations = {.viewProj      = glGetUniformLocation(m_terrainProgram, "viewProj"),
+                          .patchSize     = glGetUniformLocation(m_terrainProgram, "patchSize"),
+                          .heightScale   = glGetUniformLocation(m_terrainProgram, "heightScale"),
+                          .viewportSize  = glGetUniformLocation(m_terrainProgram, "viewportSize"),
+                          .pixelsPerEdge = glGetUniformLocation(m_terrainProgram, "pixelsPerEdge")};
+    glProgramUniform1i(m_terrainProgram, glGetUniformLocation(m_terrainProgram, "heightSampler"), 0);
+    glProgramUniform1i(m_terrainProgram, glGetUniformLocation(m_terrainProgram, "normalSampler"), 1);
+
+    // The patch buffer is attached when drawing, it changes with the resolution
+    glCreateVertexArrays(1, &m_terrainVertexArray);
+    glEnableVertexArrayAttrib(m_terrainVertexArray, 0);
+    glVertexArrayAttribFormat(m_terrainVertexArray, 0, 4, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(m_terrainVertexArray, 0, 0);
+  }
+
+  // Draws the terrain in the whole window, seen from a camera orbiting with the animation
+  void drawTerrain()
+  {
+    const float     angle  = m_animationTime * 0.05f;
+    const glm::vec3 eye    = {0.9f * cosf(angle), 0.45f, 0.9f * sinf(angle)};
+    const glm::mat4 view   = glm::lookAt(eye, glm::vec3(0.f, 0.05f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+    const float     aspect = float(m_size.width) / float(std::max(m_size.height, 1u));
+    // OpenGL clip space
+    const glm::mat4 viewProj = glm::perspective(glm::radians(50.f), aspect, 0.01f, 10.f) * view;
+
+    glUseProgram(m_terrainProgram);
+    glProgramUniformMatrix4fv(m_terrainProgram, m_terrainLocations.viewProj, 1, GL_FALSE, &viewProj[0][0]);
+    glProgramUniform1f(m_terrainProgram, m_terrainLocations.patchSize, float(TerrainVk::kPatchSize) / float(m_terrain.resolution()));
+    glProgramUniform1f(m_terrainProgram, m_terrainLocations.heightScale, m_terrainSettings.heightScale);
+    glProgramUniform2f(m_terrainProgram, m_terrainLocations.viewportSize, float(m_size.width), float(m_size.height));
+    glProgramUniform1f(m_terrainProgram, m_terrainLocations.pixelsPerEdge, m_terrainSettings.pixelsPerEdge);
+    glBindTextureUnit(0, m_terrain.heightTexture());
+    glBindTextureUnit(1, m_terrain.normalTexture());
+    glVertexArrayVertexBuffer(m_terrainVertexArray, 0, m_terrain.patchBuffer(), 0, 4 * sizeof(float));
+    glBindVertexArray(m_terrainVertexArray);
+
+    glEnable(GL_DEPTH_TEST);
+    if(m_terrainSettings.wireframe)
+      glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    glPatchParameteri(GL_PATCH_VERTICES, 1);
+    glDrawArrays(GL_PATCHES, 0, GLsizei(m_terrain.patchCount()));
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDisable(GL_DEPTH_TEST);
+    glBindTextureUnit(0, 0);
+    glBindTextureUnit(1, 0);
+  }
+
+  //--------------------------------------------------------------------------------------------------
+  // OpenGL program ray-marching the volume of VolumeVk, the unit cube centered at the origin, with a
+  // full screen triangle. Each ray steps one voxel at a time through the cube, accumulating the
+  // emission and absorption of the density front to back. With empty-space skipping, a step in a
+  // brick whose occupancy is below the threshold jumps to the exit of the brick instead.
+  //
+  void createVolumeProgram()
+  {
+    GLchar const* vss = {R"(
+      #version 450
+      out vec2 vNdc;
+
+      void main()
+      {
+        vNdc        = vec2((gl_VertexID & 1) * 4 - 1, (gl_VertexID & 2) * 2 - 1);
+        gl_Position = vec4(vNdc, 0.0, 1.0);
+      }
+    )"};
+
+    GLchar const* fss = {R"(
+      #version 450
+      in vec2 vNdc;
+      layout(location = 0) out vec4 fragColor;
+
+      uniform vec3      eye;
+      uniform vec3      right;    // Scaled by the half width of the view at distance 1
+      uniform vec3      up;       // Scaled by the half height of the view at distance 1
+      uniform vec3      forward;
+      uniform float     threshold;
+      uniform float     densityScale;
+      uniform bool      skipEmpty;
+      uniform bool      showSteps;
+      uniform sampler3D densitySampler;
+      uniform sampler3D occupancySampler;
+
+      void main()
+      {
+        const vec3 background = mix(vec3(0.05, 0.05, 0.08), vec3(0.25, 0.3, 0.4), vNdc.y * 0.5 + 0.5);
+        // In UVW of the volume
+        const vec3 origin = eye + 0.5;
+        vec3       dir    = normalize(forward + vNdc.x * right + vNdc.y * up);
+        dir               = mix(dir, vec3(1e-6), lessThan(abs(dir), vec3(1e-6)));
+        const vec3 invDir = 1.0 / dir;
+
+        const vec3  t0    = -origin * invDir;
+        const vec3  t1    = (1.0 - origin) * invDir;
+        const vec3  tMin  = min(t0, t1);
+        const vec3  tMax  = max(t0, t1);
+        const float tNear = max(max(tMin.x, max(tMin.y, tMin.z)), 0.0);
+        const float tFar  = min(tMax.x, min(tMax.y, tMax.z));
+        if(tNear >= tFar)
+        {
+          fragColor = vec4(showSteps ? vec3(0.0) : background, 1.0);
+          return;
+        }
+
+        const float stepSize      = 1.0 / float(textureSize(densitySampler, 0).x);
+        const vec3  bricks        = vec3(textureSize(occupancySampler, 0));
+        vec3        color         = vec3(0.0);
+        float       transmittance = 1.0;
+        int         steps         = 0;
+        float       t             = tNear + 0.5 * stepSize;
+        while(t < tFar && transmittance > 0.01)
+        {
+          steps++;
+          const vec3 p = origin + dir * t;
+          if(skipEmpty)
+          {
+            const vec3 brick = clamp(floor(p * bricks), vec3(0.0), bricks - 1.0);
+            if(texelFetch(occupancySampler, ivec3(brick), 0).r < threshold)
+            {
+              // To the first step past the exit of the brick, keeping the steps where they would be
+              const vec3  tExit = ((brick + step(0.0, dir)) / bricks - origin) * invDir;
+              const float tLeft = min(tExit.x, min(tExit.y, tExit.z));
+              t += max(ceil((tLeft - t) / stepSize), 1.0) * stepSize;
+              continue;
+            }
+          }
+          const float density = textureLod(densitySampler, p, 0.0).r;
+          if(density >= threshold)
+          {
+            const float alpha  = 1.0 - exp(-density * densityScale * stepSize);
+            const vec3  albedo = mix(vec3(0.3, 0.5, 0.9), vec3(1.0, 0.85, 0.7), density);
+            color += transmittance * alpha * albedo;
+            transmittance *= 1.0 - alpha;
+          }
+          t += stepSize;
+        }
+
+        // Steps relative to one per voxel across the volume
+        const float heat = float(steps) * stepSize;
+        fragColor        = vec4(showSteps ? mix(vec3(0.0, 0.0, 0.5), vec3(1.0, 0.2, 0.0), clamp(heat, 0.0, 1.0)) :
+                                            color + transmittance * background, 1.0);
+      }
+    )"};
+
+    const GLenum        stages[2]  = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    const GLchar* const sources[2] = {vss, fss};
+    m_volumeProgram                = glCreateProgram();
+    for(int i = 0; i < 2; i++)
+    {
+      GLuint shader = glCreateShader(stages[i]);
+      glShaderSource(shader, 1, &sources[i], nullptr);
+      glCompileShader(shader);
+      GLint compiled = GL_FALSE;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+      if(compiled != GL_TRUE)
+      {
+        char log[512];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        LOGE("Volume shader: %s\n", log);
+      }
+      glAttachShader(m_volumeProgram, shader);
+      glDeleteShader(shader);
+    }
+    glLinkProgram(m_volumeProgram);
+    m_volumeLocations = {.eye          = glGetUniformLocation(m_volumeProgram, "eye"),
+                         .right        = glGetUniformLocation(m_volumeProgram, "right"),
+                         .up           = glGetUniformLocation(m_volumeProgram, "up"),
+                         .forward      = glGetUniformLocation(m_volumeProgram, "forward"),
+                         .threshold    = glGetUniformLocation(m_volumeProgram, "threshold"),
+                         .densityScale = glGetUniformLocation(m_volumeProgram, "densityScale"),
+                         .skipEmpty    = glGetUniformLocation(m_volumeProgram, "skipEmpty"),
+                         .showSteps    = glGetUniformLocation(m_volumeProgram, "showSteps")};
+    glProgramUniform1i(m_volumeProgram, glGetUniformLocation(m_volumeProgram, "densitySampler"), 0);
+    glProgramUniform1i(m_volumeProgram, glGetUniformLocation(m_volumeProgram, "occupancySampler"), 1);
+    glCreateVertexArrays(1, &m_volumeVertexArray);
+  }
+
+  // Ray-marches the volume in the whole window, seen from a camera orbiting with the animation
+  void drawVolume()
+  {
+    const float     angle   = m_animationTime * 0.1f;
+    const glm::vec3 eye     = {1.5f * cosf(angle), 0.5f, 1.5f * sinf(angle)};
+    const glm::vec3 forward = glm::normalize(-eye);
+    const float     tanHalf = tanf(glm::radians(50.f) * 0.5f);
+    const float     aspect  = float(m_size.width) / float(std::max(m_size.height, 1u));
+    const glm::vec3 side    = glm::normalize(glm::cross(forward, glm::vec3(0.f, 1.f, 0.f)));
+    // Half extents of the view at distance 1
+    const glm::vec3 right = side * tanHalf * aspect;
+    const glm::vec3 up    = glm::cross(side, forward) * tanHalf;
+
+    glUseProgram(m_volumeProgram);
+    glProgramUniform3fv(m_volumeProgram, m_volumeLocations.eye, 1, &eye[0]);
+    glProgramUniform3fv(m_volumeProgram, m_volumeLocations.right, 1, &right[0]);
+    glProgramUniform3fv(m_volumeProgram, m_volumeLocations.up, 1, &up[0]);
+    glProgramUniform3fv(m_volumeProgram, m_volumeLocations.forward, 1, &forward[0]);
+    glProgramUniform1f(m_volumeProgram, m_volumeLocations.threshold, m_volumeSettings.threshold);
+    glProgramUniform1f(m_volumeProgram, m_volumeLocations.densityScale, m_volumeSettings.densityScale);
+    glProgramUniform1i(m_volumeProgram, m_volumeLocations.skipEmpty, m_volumeSettings.skipEmpty);
+    glProgramUniform1i(m_volumeProgram, m_volumeLocations.showSteps, m_volumeSettings.showSteps);
+    glBindTextureUnit(0, m_volume.densityTexture());
+    glBindTextureUnit(1, m_volume.occupancyTexture());
+    glBindVertexArray(m_volumeVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindTextureUnit(0, 0);
+    glBindTextureUnit(1, 0);
+  }
+
   //--------------------------------------------------------------------------------------------------
   // Initialization of the GUI
   // - Need to be call after the device creation
@@ -296,6 +1537,20 @@ public:
     ImGui::InitGL();
   }
 
+  // When paused, frames are only drawn in response to events
+  bool isAnimating() const
+  {
+    return m_animate || m_benchmark.isRunning() || m_blurBenchmark.isRunning() || m_hdrBenchmark.isRunning()
+           || m_scanBenchmark.isRunning();
+  }
+  bool throttleUnfocused() const
+  {
+    return m_throttleUnfocused && !m_benchmark.isRunning() && !m_blurBenchmark.isRunning() && !m_hdrBenchmark.isRunning()
+           && !m_scanBenchmark.isRunning();
+  }
+
+  FramePacer& framePacer() { return m_framePacer; }
+
   //- Override the default resize
   void onFramebufferSize(int w, int h) override
   {
@@ -316,11 +1571,86 @@ public:
 private:
   nvvk::BufferVkGL                       m_bufferVk;
   nvvk::ExportResourceAllocatorDedicated m_alloc;
-
-  GLuint m_vertexArray = 0;  // VAO
-  GLuint m_programID   = 0;  // Shader program
-
-  ComputeImageVk m_compute;  // Compute in Vulkan
+  nvvk::InteropRegistry                  m_interop;  // Interop resources of the frame, by submission
+
+  GLuint m_vertexArray             = 0;   // VAO
+  GLuint m_programID               = 0;   // Shader program
+  GLint  m_tileRectLocation        = -1;  // UV region of the tile being drawn
+  GLint  m_viewRectLocation        = -1;  // UV region shown by the view
+  GLint  m_autoExposureLocation    = -1;  // Whether the tile's Exposure block is bound
+  GLint  m_toneMapOperatorLocation = -1;  // Of the tile being drawn
+  GLint  m_whitePointLocation      = -1;
+  GLint  m_sdfOutlineLocation      = -1;  // Whether the tile's distance field is bound to unit 1
+  GLint  m_outlineWidthLocation    = -1;
+
+  std::vector<std::unique_ptr<TiledImageVk>> m_producers;  // Compute in Vulkan, one per grid cell, not movable
+
+  uint32_t                    m_queueIdxCompute{0};         // Queue family of the producers
+  std::vector<uint32_t>       m_computeQueues;              // Queue indices available in that family
+  uint32_t                    m_activeQueues{1};            // How many of them the producers use
+  ComputeFeatures             m_deviceFeatures;             // Optional features enabled on the device
+  ComputeFeatures             m_computeFeatures;            // The ones the producers use
+  nvvk::BindlessImageTable    m_bindlessTable;              // Images of all producers, with descriptor indexing
+  nvvk::ShaderObjectCache     m_shaderObjectCache;          // Binaries of the shader objects, saved at exit
+  PipelineCreationStats       m_pipelineStats;              // Creation feedback of all compute pipelines
+  ComputePipelineCache        m_pipelineCache;              // Of all compute pipelines, saved at exit
+  const ComputeShaderVariant* m_kernelVariant{nullptr};     // Kernel selected in the UI, nullptr for the best
+  double                      m_kernelSwitchMs{0.0};
+  VkExtent2D                  m_textureSize{1024, 1024};    // Size of each producer's (logical) texture
+  uint32_t                    m_maxTileDimension{0};        // User limit of the tile size, 0 for the device limit
+  float                       m_viewZoom{1.f};              // Magnification of the view
+  float                       m_viewCenter[2]{0.5f, 0.5f};  // Center of the view, in UV
+  nvvk::SparseInteropSupport  m_sparseSupport;              // What is missing for sparse interop images
+  bool                        m_useSparse{false};
+  int                         m_pingPongIterations{0};      // Per frame, 0 for shader.comp
+  ScalingBenchmark            m_benchmark;
+  FramePacer::SwapMode        m_swapModeBeforeBenchmark{FramePacer::eVsync};
+  BlurSettings                m_blurSettings;               // Of all producers, while no benchmark runs
+  GpuPassBenchmark            m_blurBenchmark;
+  ExposureSettings            m_exposureSettings;
+  BlockCompressSettings       m_compressSettings;
+  SdfSettings                 m_sdfSettings;
+  bool                        m_hdr{false};                 // RGBA16F images, while no HDR benchmark runs
+  ToneMapSettings             m_toneMapSettings;
+  GpuPassBenchmark            m_hdrBenchmark;
+  nvgl::GpuTimer              m_presentTimer;               // Drawing of the producers' images
+  ScanBenchmarkVk             m_scanWorkload;               // Created while the scan benchmark runs
+  GpuPassBenchmark            m_scanBenchmark;
+  std::vector<ScanSettings>   m_scanVariants;               // Of the scan benchmark
+  bool                        m_scanCompact{false};         // Benchmark the compaction instead of the scan
+  TerrainVk                   m_terrain;                    // Created when first enabled
+  TerrainSettings             m_terrainSettings;
+  GLuint                      m_terrainProgram{0};
+  GLuint                      m_terrainVertexArray{0};      // One vertex per patch, from the patch buffer
+  struct TerrainLocations
+  {
+    GLint viewProj{-1};
+    GLint patchSize{-1};
+    GLint heightScale{-1};
+    GLint viewportSize{-1};
+    GLint pixelsPerEdge{-1};
+  } m_terrainLocations;                                     // Uniforms of m_terrainProgram
+  VolumeVk                    m_volume;                     // Created when first enabled
+  VolumeSettings              m_volumeSettings;
+  GLuint                      m_volumeProgram{0};
+  GLuint                      m_volumeVertexArray{0};       // Empty, the full screen triangle is generated
+  struct VolumeLocations
+  {
+    GLint eye{-1};
+    GLint right{-1};
+    GLint up{-1};
+    GLint forward{-1};
+    GLint threshold{-1};
+    GLint densityScale{-1};
+    GLint skipEmpty{-1};
+    GLint showSteps{-1};
+  } m_volumeLocations;                                      // Uniforms of m_volumeProgram
+  FramePacer                  m_framePacer;
+
+  bool  m_animate{true};            // When false, redraw only on events
+  bool  m_throttleUnfocused{true};  // Lower the frame rate when the window has no focus
+  float m_animationTime{0.f};       // Seconds of animation, frozen while paused
+  std::chrono::high_resolution_clock::time_point m_lastFrameTime{std::chrono::high_resolution_clock::now()};
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -332,6 +1662,7 @@ int main(int argc, char** argv)
   NVPSystem system(PROJECT_NAME);
 
   nvprintSetBreakpoints(true);  // DEBUG
+  const auto startupBegin = std::chrono::high_resolution_clock::now();
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
   // Create window with graphics context
@@ -339,7 +1670,6 @@ int main(int argc, char** argv)
   if(window == nullptr)
     return 1;
   glfwMakeContextCurrent(window);
-  glfwSwapInterval(1);  // Enable vsync
 
   nvvk::ContextCreateInfo deviceInfo;
   deviceInfo.addInstanceExtension(VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME);
@@ -353,6 +1683,17 @@ int main(int argc, char** argv)
   deviceInfo.addDeviceExtension(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
   deviceInfo.addDeviceExtension(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME);
 #endif
+  // Ask for extra queues of the graphics/compute family, so that independent producers can be
+  // submitted to separate hardware queues. Fewer queues may be created if the family has less.
+  deviceInfo.addRequestedQueue(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT,
+                               MAX_COMPUTE_QUEUES - 1);
+  // Optional: descriptors written in the command buffer, without sets
+  deviceInfo.addDeviceExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME, true);
+  // Optional: shaders bound without pipelines, for fast kernel switching
+  VkPhysicalDeviceShaderObjectFeaturesEXT shaderObjectFeatures{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT};
+  deviceInfo.addDeviceExtension(VK_EXT_SHADER_OBJECT_EXTENSION_NAME, true, &shaderObjectFeatures);
+  // Optional: creation time and pipeline cache hits of the compute pipelines (core in Vulkan 1.3)
+  deviceInfo.addDeviceExtension(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME, true);
 
   // Creating the Vulkan instance and device
   nvvk::Context vkctx;
@@ -361,6 +1702,7 @@ int main(int argc, char** argv)
     LOGE("Could not initialize the Vulkan instance and device! See the above messages for more info.\n");
     return EXIT_FAILURE;
   }
+  const auto deviceReady = std::chrono::high_resolution_clock::now();
 
 
   InteropExample      example;
@@ -382,32 +1724,90 @@ int main(int argc, char** argv)
   // Initialize the window, UI ..
   example.initUI(SAMPLE_SIZE_WIDTH, SAMPLE_SIZE_HEIGHT);
 
+  // Gather the queues of the compute family; queue 0 of m_queueGCT is always part of it
+  std::vector<uint32_t> computeQueues{vkctx.m_queueGCT.queueIndex};
+  while(computeQueues.size() < MAX_COMPUTE_QUEUES)
+  {
+    nvvk::Context::Queue queue = vkctx.createQueue(VK_QUEUE_COMPUTE_BIT, "queueProducer");
+    if(queue.queue == VK_NULL_HANDLE)
+      break;
+    if(queue.familyIndex == vkctx.m_queueGCT.familyIndex)
+      computeQueues.push_back(queue.queueIndex);
+  }
+  LOGI("%zu queue(s) available for compute\n", computeQueues.size());
+
+  // Descriptor indexing is core in Vulkan 1.2, nvvk::Context enables the supported features
+  ComputeFeatures computeFeatures{
+      .pushDescriptor   = vkctx.hasDeviceExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME),
+      .bindless         = nvvk::BindlessImageTable::isSupported(vkctx.m_physicalDevice),
+      .shaderObject     = vkctx.hasDeviceExtension(VK_EXT_SHADER_OBJECT_EXTENSION_NAME) && shaderObjectFeatures.shaderObject == VK_TRUE,
+      .pipelineFeedback = vkctx.hasDeviceExtension(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME)};
+  LOGI("Push descriptors: %s, bindless images: %s, shader objects: %s\n", computeFeatures.pushDescriptor ? "yes" : "no",
+       computeFeatures.bindless ? "yes" : "no", computeFeatures.shaderObject ? "yes" : "no");
+
   // Prepare the example
-  example.prepare(vkctx.m_queueGCT.familyIndex);
+  example.prepare(vkctx.m_queueGCT.familyIndex, computeQueues, computeFeatures);
+  const auto prepared = std::chrono::high_resolution_clock::now();
+  example.logStartupReport(std::chrono::duration<double, std::milli>(deviceReady - startupBegin).count(),
+                           std::chrono::duration<double, std::milli>(prepared - deviceReady).count());
 
 
+  // Vsync by default, selectable in the UI
+  example.framePacer().init();
+
   // GLFW Callback
   example.setupGlfwCallbacks(window);
   ImGui_ImplGlfw_InitForOpenGL(window, false);
 
   // Main loop
+  int settleFrames = 0;
   while(!glfwWindowShouldClose(window))
   {
-    glfwPollEvents();
     int w, h;
     glfwGetWindowSize(window, &w, &h);
-    if(w == 0 || h == 0)
+    if(w == 0 || h == 0 || glfwGetWindowAttrib(window, GLFW_ICONIFIED))
+    {
+      // Minimized: sleep until something happens, nothing gets submitted to Vulkan meanwhile
+      glfwWaitEvents();
       continue;
+    }
+
+    if(!example.isAnimating())
+    {
+      // Event-driven: block until input, then draw a few frames so that the UI settles
+      if(settleFrames == 0)
+      {
+        glfwWaitEvents();
+        settleFrames = SETTLE_FRAMES;
+      }
+      else
+      {
+        glfwPollEvents();
+        settleFrames--;
+      }
+    }
+    else if(example.throttleUnfocused() && !glfwGetWindowAttrib(window, GLFW_FOCUSED))
+    {
+      // Likely covered by other windows: keep animating, at a low rate
+      glfwWaitEventsTimeout(1.0 / UNFOCUSED_FPS);
+    }
+    else
+    {
+      glfwPollEvents();
+    }
 
     glClearColor(0.5f, 0.0f, 0.0f, 0.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    example.framePacer().beginFrame();
     example.animate();
     example.onWindowRefresh();
 
     glfwSwapBuffers(window);
+    example.framePacer().endFrame();
   }
 
+  example.framePacer().deinit();
   example.destroy();
   vkctx.deinit();
 
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "nvh/nvprint.hpp"
+#include "nvvk/error_vk.hpp"
+
+// Creation time of the compute pipelines and whether they were found in the pipeline cache, as
+// reported by the driver with VkPipelineCreationFeedbackCreateInfo
+struct PipelineCreationStats
+{
+  struct Record
+  {
+    const char* name;      // File of the shader
+    double      ms;        // Creation time
+    bool        cacheHit;  // Found in the ComputePipelineCache
+  };
+  std::vector<Record> records;
+
+  void add(const char* name, uint64_t durationNs, bool cacheHit)
+  {
+    records.push_back({name, double(durationNs) * 1e-6, cacheHit});
+  }
+  void clear() { records.clear(); }
+
+  uint32_t count() const { return uint32_t(records.size()); }
+  uint32_t cacheHits() const
+  {
+    return uint32_t(std::count_if(records.begin(), records.end(), [](const Record& r) { return r.cacheHit; }));
+  }
+  double totalMs() const
+  {
+    double total = 0.0;
+    for(const Record& r : records)
+      total += r.ms;
+    return total;
+  }
+};
+
+//--------------------------------------------------------------------------------------------------
+// The VkPipelineCache of all compute pipelines of the application, loaded from a file at startup
+// and saved at exit, so that the pipelines of a previous run are cache hits. With `stats`, the
+// creation feedback of every pipeline created through createCompute() is recorded there.
+//
+class ComputePipelineCache
+{
+public:
+  // `filename` is loaded when it was saved on the same device and driver; `stats` may be null
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, const std::string& filename, PipelineCreationStats* stats)
+  {
+    m_device = device;
+    m_stats  = stats;
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    std::ifstream        file(filename, std::ios::binary);
+    std::vector<uint8_t> data;
+    if(file)
+      data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    // The driver ignores data of another device, checked here to report it
+    VkPipelineCacheHeaderVersionOne header{};
+    if(data.size() >= sizeof(header))
+      memcpy(&header, data.data(), sizeof(header));
+    if(!data.empty()
+       && (data.size() < sizeof(header) || header.vendorID != properties.vendorID || header.deviceID != properties.deviceID
+           || memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0))
+    {
+      LOGI("Pipeline cache %s is for another device or driver, ignored\n", filename.c_str());
+      data.clear();
+    }
+    else if(!data.empty())
+      LOGI("Pipeline cache: %zu bytes loaded\n", data.size());
+
+    VkPipelineCacheCreateInfo createInfo{.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                                         .initialDataSize = data.size(),
+                                         .pInitialData    = data.data()};
+    NVVK_CHECK(vkCreatePipelineCache(device, &createInfo, nullptr, &m_cache));
+  }
+
+  void deinit()
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+    vkDestroyPipelineCache(m_device, m_cache, nullptr);
+    m_cache  = VK_NULL_HANDLE;
+    m_device = VK_NULL_HANDLE;
+  }
+
+  bool isValid() const { return m_device != VK_NULL_HANDLE; }
+
+  bool save(const std::string& filename) const
+  {
+    size_t size = 0;
+    NVVK_CHECK(vkGetPipelineCacheData(m_device, m_cache, &size, nullptr));
+    std::vector<uint8_t> data(size);
+    NVVK_CHECK(vkGetPipelineCacheData(m_device, m_cache, &size, data.data()));
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(size));
+    return bool(file);
+  }
+
+  // vkCreateComputePipelines with the cache. The feedback is recorded under `name`, the file of the
+  // shader.
+  VkPipeline createCompute(const VkComputePipelineCreateInfo& info, const char* name) const
+  {
+    VkPipelineCreationFeedback           feedback{};
+    VkPipelineCreationFeedbackCreateInfo feedbackInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO,
+                                                      .pNext = info.pNext,
+                                                      .pPipelineCreationFeedback = &feedback};
+    VkComputePipelineCreateInfo createInfo = info;
+    if(m_stats)
+      createInfo.pNext = &feedbackInfo;
+    VkPipeline pipeline{};
+    NVVK_CHECK(vkCreateComputePipelines(m_device, m_cache, 1, &createInfo, nullptr, &pipeline));
+
+    if(m_stats && (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT))
+      m_stats->add(name, feedback.duration, (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT) != 0);
+    return pipeline;
+  }
+
+private:
+  VkDevice               m_device{};
+  VkPipelineCache        m_cache{};
+  PipelineCreationStats* m_stats{nullptr};  // Creation feedback, when the device supports it
+};
@@ -0,0 +1,517 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include "gl_vk.hpp"
+#include "gpu_timer.hpp"
+#include "pipeline_cache.hpp"
+#include "spirv.hpp"
+#include "nvh/nvprint.hpp"
+#include "nvvk/commands_vk.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "scan_comp_shared_spv.h"
+#include "scan_comp_subgroup_spv.h"
+
+struct ScanSettings
+{
+  enum Algorithm : int
+  {
+    eReduceThenScan,  // Three passes
+    eLookBack,        // Single pass with decoupled look-back, see ScanPass::isLookBackSupported()
+  };
+  Algorithm algorithm{eLookBack};
+  bool      subgroup{true};  // Subgroup arithmetic when supported, shared memory otherwise
+
+  bool operator==(const ScanSettings&) const = default;
+};
+
+// Must match the push_constant block of shaders/scan.comp
+struct ScanPushConstants
+{
+  uint32_t pass;
+  uint32_t count;
+  uint32_t compact;
+  uint32_t partitionCount;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Exclusive prefix sum and stream compaction of buffers of uint32_t on the GPU, a building block
+// for GPU-driven work (draw compaction, particle emission, tile lists). The buffers are typically
+// the Vulkan side of BufferVkGL, which OpenGL then binds as storage or indirect buffers.
+// - recordScan(): output[i] = input[0] + ... + input[i - 1], and the sum of all of them in `total`
+// - recordCompact(): the indices of the nonzero elements of input, in order, and their number in
+//   `total`, which can be the count of an indirect draw or dispatch
+// Sums, including the total, must fit in 30 bits: the look-back packs a flag with them.
+// The descriptor set is updated when recording with other buffers than the previous time, so a
+// ScanPass records for a single set of buffers per submission; use one ScanPass per set.
+// The look-back clears `total` with a transfer when there are no elements: it needs TRANSFER_DST usage.
+//
+class ScanPass
+{
+public:
+  static constexpr uint32_t kPartitionSize = 256 * 4;  // PARTITION_SIZE of the shader
+
+  // Subgroup arithmetic in compute shaders
+  static bool isSubgroupSupported(VkPhysicalDevice physicalDevice)
+  {
+    VkPhysicalDeviceSubgroupProperties subgroup{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &subgroup};
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    return (subgroup.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT)
+           && (subgroup.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT);
+  }
+
+  // The look-back waits for workgroups that started earlier, which Vulkan does not guarantee to make
+  // progress meanwhile. NVIDIA and AMD GPUs do; elsewhere the three passes are used.
+  static bool isLookBackSupported(VkPhysicalDevice physicalDevice)
+  {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    return properties.vendorID == 0x10DE || properties.vendorID == 0x1002;
+  }
+
+  // `maxCount` bounds the number of elements of a scan
+  void init(VkDevice                    device,
+            VkPhysicalDevice            physicalDevice,
+            const ComputePipelineCache& pipelineCache,
+            nvvk::ResourceAllocator&    alloc,
+            uint32_t                    queueFamily,
+            uint32_t                    maxCount)
+  {
+    m_device   = device;
+    m_lookBack = isLookBackSupported(physicalDevice);
+    m_timer.init(device, physicalDevice, queueFamily);
+
+    m_maxPartitions = (maxCount + kPartitionSize - 1) / kPartitionSize;
+    m_partitions    = alloc.createBuffer((1 + VkDeviceSize(m_maxPartitions)) * sizeof(uint32_t),
+                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    m_descriptors.init(device);
+    for(uint32_t binding = 0; binding < 4; binding++)
+      m_descriptors.addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.initLayout();
+    m_descriptors.initPool(1);
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(ScanPushConstants)};
+    m_descriptors.initPipeLayout(1, &pushConstants);
+
+    const VkDescriptorBufferInfo partitions{m_partitions.buffer, 0, VK_WHOLE_SIZE};
+    const VkWriteDescriptorSet   write = m_descriptors.makeWrite(0, 2, &partitions);
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    m_buffers = {};
+
+    m_sharedPipeline = createPipeline(pipelineCache, makeSpirvShader("shaders/scan_comp_shared.spv", scan_comp_shared_spv));
+    if(isSubgroupSupported(physicalDevice))
+      m_subgroupPipeline = createPipeline(pipelineCache, makeSpirvShader("shaders/scan_comp_subgroup.spv", scan_comp_subgroup_spv));
+  }
+
+  void deinit(nvvk::ResourceAllocator& alloc)
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+    alloc.destroy(m_partitions);
+    vkDestroyPipeline(m_device, m_sharedPipeline, nullptr);
+    vkDestroyPipeline(m_device, m_subgroupPipeline, nullptr);
+    m_subgroupPipeline = VK_NULL_HANDLE;
+    m_descriptors.deinit();
+    m_timer.deinit();
+    m_device = VK_NULL_HANDLE;
+  }
+
+  bool     isValid() const { return m_device != VK_NULL_HANDLE; }
+  uint32_t maxCount() const { return m_maxPartitions * kPartitionSize; }
+
+  // What record() runs for `settings`, given what the device supports
+  ScanSettings effectiveSettings(const ScanSettings& settings) const
+  {
+    return {.algorithm = m_lookBack ? settings.algorithm : ScanSettings::eReduceThenScan,
+            .subgroup  = settings.subgroup && m_subgroupPipeline != VK_NULL_HANDLE};
+  }
+
+  // Exclusive prefix sum of `count` elements of `input` into `output`, and their sum into `total`
+  void recordScan(VkCommandBuffer               cmd,
+                  const VkDescriptorBufferInfo& input,
+                  const VkDescriptorBufferInfo& output,
+                  const VkDescriptorBufferInfo& total,
+                  uint32_t                      count,
+                  const ScanSettings&           settings)
+  {
+    record(cmd, input, output, total, count, false, settings);
+  }
+
+  // Indices of the nonzero elements among `count` of `input` into `output`, and their number into `total`
+  void recordCompact(VkCommandBuffer               cmd,
+                     const VkDescriptorBufferInfo& input,
+                     const VkDescriptorBufferInfo& output,
+                     const VkDescriptorBufferInfo& total,
+                     uint32_t                      count,
+                     const ScanSettings&           settings)
+  {
+    record(cmd, input, output, total, count, true, settings);
+  }
+
+  // GPU time of the last scan or compaction measured, negative if there is none
+  double lastGpuMs() const { return m_timer.lastMs(); }
+
+private:
+  // Compute shader writes and transfers before are visible, and the results are visible to compute
+  // shaders and indirect commands after
+  void record(VkCommandBuffer               cmd,
+              const VkDescriptorBufferInfo& input,
+              const VkDescriptorBufferInfo& output,
+              const VkDescriptorBufferInfo& total,
+              uint32_t                      count,
+              bool                          compact,
+              const ScanSettings&           settings)
+  {
+    assert(count <= maxCount());
+    const Buffers buffers{input, output, total};
+    if(!buffers.equals(m_buffers))
+    {
+      const VkWriteDescriptorSet writes[3] = {m_descriptors.makeWrite(0, 0, &input), m_descriptors.makeWrite(0, 1, &output),
+                                              m_descriptors.makeWrite(0, 3, &total)};
+      vkUpdateDescriptorSets(m_device, 3, writes, 0, nullptr);
+      m_buffers = buffers;
+    }
+
+    const ScanSettings effective = effectiveSettings(settings);
+    ScanPushConstants  pushc{.count = count, .compact = compact, .partitionCount = (count + kPartitionSize - 1) / kPartitionSize};
+    const VkDescriptorSet set = m_descriptors.getSet(0);
+
+    VkMemoryBarrier before{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                           .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                           .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0, nullptr, 0, nullptr);
+
+    m_timer.begin(cmd);
+    if(effective.algorithm == ScanSettings::eLookBack)
+    {
+      // Counter and statuses of the partitions start at 0
+      vkCmdFillBuffer(cmd, m_partitions.buffer, 0, (1 + VkDeviceSize(pushc.partitionCount)) * sizeof(uint32_t), 0);
+      // Without elements no workgroup runs to write the total, the scan of the partials does otherwise
+      if(count == 0)
+        vkCmdFillBuffer(cmd, total.buffer, total.offset, sizeof(uint32_t), 0);
+      VkMemoryBarrier fillBarrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                  .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                                  .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+      vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &fillBarrier,
+                           0, nullptr, 0, nullptr);
+    }
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, effective.subgroup ? m_subgroupPipeline : m_sharedPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_descriptors.getPipeLayout(), 0, 1, &set, 0, nullptr);
+    if(effective.algorithm == ScanSettings::eLookBack)
+    {
+      pushc.pass = 3;
+      dispatch(cmd, pushc, pushc.partitionCount);
+    }
+    else
+    {
+      pushc.pass = 0;
+      dispatch(cmd, pushc, pushc.partitionCount);
+      barrier(cmd);
+      pushc.pass = 1;
+      dispatch(cmd, pushc, 1);
+      barrier(cmd);
+      pushc.pass = 2;
+      dispatch(cmd, pushc, pushc.partitionCount);
+    }
+    m_timer.end(cmd);
+
+    VkMemoryBarrier after{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                          .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                          .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &after, 0,
+                         nullptr, 0, nullptr);
+  }
+
+  void dispatch(VkCommandBuffer cmd, const ScanPushConstants& pushc, uint32_t groups)
+  {
+    vkCmdPushConstants(cmd, m_descriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+    if(groups > 0)
+      vkCmdDispatch(cmd, groups, 1, 1);
+  }
+
+  static void barrier(VkCommandBuffer cmd)
+  {
+    VkMemoryBarrier barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  VkPipeline createPipeline(const ComputePipelineCache& pipelineCache, const SpirvShader& shader)
+  {
+    VkPipelineShaderStageCreateInfo stage{.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                          .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                          .module = createShaderModule(m_device, shader),
+                                          .pName  = "main"};
+    VkComputePipelineCreateInfo pipelineInfo{.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                             .stage  = stage,
+                                             .layout = m_descriptors.getPipeLayout()};
+    VkPipeline pipeline = pipelineCache.createCompute(pipelineInfo, shader.filename);
+    vkDestroyShaderModule(m_device, stage.module, nullptr);
+    return pipeline;
+  }
+
+  // Buffers of the descriptor set
+  struct Buffers
+  {
+    VkDescriptorBufferInfo input, output, total;
+
+    bool equals(const Buffers& other) const
+    {
+      const auto same = [](const VkDescriptorBufferInfo& a, const VkDescriptorBufferInfo& b) {
+        return a.buffer == b.buffer && a.offset == b.offset && a.range == b.range;
+      };
+      return same(input, other.input) && same(output, other.output) && same(total, other.total);
+    }
+  };
+
+  VkDevice                     m_device{};
+  nvvk::DescriptorSetContainer m_descriptors;
+  VkPipeline                   m_sharedPipeline{};
+  VkPipeline                   m_subgroupPipeline{};  // When subgroup arithmetic is supported
+  bool                         m_lookBack{false};
+  nvvk::Buffer                 m_partitions;          // Counter and sum or status of each partition
+  uint32_t                     m_maxPartitions{0};
+  Buffers                      m_buffers{};
+  nvvk::GpuTimer               m_timer;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Throughput benchmark of ScanPass: scans or compacts interop buffers of random values, on their own
+// submissions to a compute queue. About a quarter of the values are zero. The first run of each
+// configuration is read back and checked against the CPU, see failedChecks().
+//
+class ScanBenchmarkVk
+{
+public:
+  static constexpr uint32_t kMaxCount = 1u << 24;
+
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, const ComputePipelineCache& pipelineCache, nvvk::ResourceAllocator& alloc, uint32_t queueFamily)
+  {
+    m_device      = device;
+    m_alloc       = &alloc;
+    m_queueFamily = queueFamily;
+    vkGetDeviceQueue(device, queueFamily, 0, &m_queue);
+
+    VkCommandPoolCreateInfo poolInfo{.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                                     .flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                                     .queueFamilyIndex = queueFamily};
+    NVVK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &m_commandPool));
+    VkCommandBufferAllocateInfo allocateInfo{.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                                             .commandPool        = m_commandPool,
+                                             .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                                             .commandBufferCount = 1};
+    NVVK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &m_commandBuffer));
+    VkFenceCreateInfo fenceInfo{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .flags = VK_FENCE_CREATE_SIGNALED_BIT};
+    NVVK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &m_fence));
+
+    m_scan.init(device, physicalDevice, pipelineCache, alloc, queueFamily, kMaxCount);
+    m_failedChecks = 0;
+  }
+
+  void deinit()
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    destroyBuffers();
+    m_scan.deinit(*m_alloc);
+    vkDestroyFence(m_device, m_fence, nullptr);
+    vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+    m_device = VK_NULL_HANDLE;
+  }
+
+  bool     isValid() const { return m_device != VK_NULL_HANDLE; }
+  uint32_t count() const { return m_count; }
+
+  // Configurations whose results did not match the CPU since init()
+  uint32_t failedChecks() const { return m_failedChecks; }
+
+  // GPU time of the last run measured, negative if there is none
+  double lastGpuMs() const { return m_scan.lastGpuMs(); }
+
+  // (Re)creates the buffers for `count` elements, at most kMaxCount, and uploads the values
+  void resize(uint32_t count)
+  {
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    destroyBuffers();
+    m_count = count;
+
+    const VkDeviceSize size = VkDeviceSize(count) * sizeof(uint32_t);
+    m_input.bufVk  = m_alloc->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_output.bufVk = m_alloc->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_total.bufVk  = m_alloc->createBuffer(sizeof(uint32_t),
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                                               | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createBufferGL(*m_alloc, m_input);
+    createBufferGL(*m_alloc, m_output);
+    createBufferGL(*m_alloc, m_total);
+
+    // Values 0 to 3 from a hash of the index: sums of kMaxCount of them fit in 30 bits
+    m_values.resize(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+      uint32_t h = i * 0x9E3779B1u;
+      h ^= h >> 15;
+      h *= 0x85EBCA77u;
+      h ^= h >> 13;
+      m_values[i] = h & 3;
+    }
+    nvvk::Buffer staging = m_alloc->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    memcpy(m_alloc->map(staging), m_values.data(), size);
+    m_alloc->unmap(staging);
+    {
+      nvvk::ScopeCommandBuffer cmd(m_device, m_queueFamily, m_queue);
+      const VkBufferCopy       region{0, 0, size};
+      vkCmdCopyBuffer(cmd, staging.buffer, m_input.bufVk.buffer, 1, &region);
+    }
+    m_alloc->destroy(staging);
+    m_checkPending = true;
+  }
+
+  // Submits a scan, or a compaction, of all elements. Waits for the previous one. The first run of
+  // a configuration also waits for this one, to check its results.
+  void run(const ScanSettings& settings, bool compact)
+  {
+    const bool check = m_checkPending || !(settings == m_settings) || compact != m_compact;
+    m_checkPending   = false;
+    m_settings       = settings;
+    m_compact        = compact;
+
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    NVVK_CHECK(vkResetFences(m_device, 1, &m_fence));
+
+    VkCommandBufferBeginInfo beginInfo{.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                                       .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+    NVVK_CHECK(vkBeginCommandBuffer(m_commandBuffer, &beginInfo));
+    const VkDescriptorBufferInfo input{m_input.bufVk.buffer, 0, VK_WHOLE_SIZE};
+    const VkDescriptorBufferInfo output{m_output.bufVk.buffer, 0, VK_WHOLE_SIZE};
+    const VkDescriptorBufferInfo total{m_total.bufVk.buffer, 0, VK_WHOLE_SIZE};
+    if(compact)
+      m_scan.recordCompact(m_commandBuffer, input, output, total, m_count, settings);
+    else
+      m_scan.recordScan(m_commandBuffer, input, output, total, m_count, settings);
+    NVVK_CHECK(vkEndCommandBuffer(m_commandBuffer));
+
+    VkSubmitInfo submitInfo{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO, .commandBufferCount = 1, .pCommandBuffers = &m_commandBuffer};
+    NVVK_CHECK(vkQueueSubmit(m_queue, 1, &submitInfo, m_fence));
+    if(check && !checkResults())
+      m_failedChecks++;
+  }
+
+private:
+  // Reads back the output and the total of the last run, and compares them with a scan, or a
+  // compaction, on the CPU
+  bool checkResults()
+  {
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    const VkDeviceSize size     = VkDeviceSize(m_count) * sizeof(uint32_t);
+    nvvk::Buffer       readback = m_alloc->createBuffer(size + sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    {
+      nvvk::ScopeCommandBuffer cmd(m_device, m_queueFamily, m_queue);
+      VkMemoryBarrier          toTransfer{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                          .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                                          .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT};
+      vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &toTransfer,
+                           0, nullptr, 0, nullptr);
+      const VkBufferCopy outputRegion{0, 0, size};
+      const VkBufferCopy totalRegion{0, size, sizeof(uint32_t)};
+      vkCmdCopyBuffer(cmd, m_output.bufVk.buffer, readback.buffer, 1, &outputRegion);
+      vkCmdCopyBuffer(cmd, m_total.bufVk.buffer, readback.buffer, 1, &totalRegion);
+      VkMemoryBarrier toHost{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                             .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                             .dstAccessMask = VK_ACCESS_HOST_READ_BIT};
+      vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &toHost, 0, nullptr, 0, nullptr);
+    }
+
+    const uint32_t* results  = static_cast<const uint32_t*>(m_alloc->map(readback));
+    uint32_t        expected = 0;  // Running sum, or number of nonzero values
+    bool            valid    = true;
+    for(uint32_t i = 0; i < m_count && valid; i++)
+    {
+      if(m_compact)
+      {
+        if(m_values[i] != 0)
+          valid = results[expected++] == i;
+      }
+      else
+      {
+        valid = results[i] == expected;
+        expected += m_values[i];
+      }
+    }
+    valid = valid && results[m_count] == expected;
+    m_alloc->unmap(readback);
+    m_alloc->destroy(readback);
+
+    if(!valid)
+      LOGE("Scan benchmark: wrong %s of %u elements (%s, %s)\n", m_compact ? "compaction" : "scan", m_count,
+           m_settings.subgroup ? "subgroup" : "shared", m_settings.algorithm == ScanSettings::eLookBack ? "look-back" : "3 passes");
+    return valid;
+  }
+
+  void destroyBuffers()
+  {
+    if(m_count == 0)
+      return;
+    m_input.destroy(*m_alloc);
+    m_output.destroy(*m_alloc);
+    m_total.destroy(*m_alloc);
+    m_input  = {};
+    m_output = {};
+    m_total  = {};
+    m_count  = 0;
+  }
+
+  VkDevice                 m_device{};
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  uint32_t                 m_queueFamily{0};
+  VkQueue                  m_queue{};
+  VkCommandPool            m_commandPool{};
+  VkCommandBuffer          m_commandBuffer{};
+  VkFence                  m_fence{};
+  ScanPass                 m_scan;
+  nvvk::BufferVkGL         m_input;   // Values
+  nvvk::BufferVkGL         m_output;  // Prefix sums, or indices of the nonzero values
+  nvvk::BufferVkGL         m_total;   // Sum, or number of nonzero values
+  uint32_t                 m_count{0};
+  std::vector<uint32_t>    m_values;  // Of m_input, for the checks
+  ScanSettings             m_settings;
+  bool                     m_compact{false};
+  bool                     m_checkPending{false};  // The next run is checked, whatever its configuration
+  uint32_t                 m_failedChecks{0};
+};
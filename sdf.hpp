@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+
+#include "gl_vk.hpp"
+#include "gpu_timer.hpp"
+#include "interop_state.hpp"
+#include "pipeline_cache.hpp"
+#include "spirv.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
+#include "nvvk/images_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "sdf_comp_spv.h"
+
+// Signed distance field of the bright parts of an interop image, outlined by OpenGL
+struct SdfSettings
+{
+  bool  enabled{false};
+  float threshold{0.5f};    // Luminance above which a pixel is inside the shape
+  float outlineWidth{2.0f}; // Half width of the outline drawn by OpenGL, in screen pixels
+
+  bool operator==(const SdfSettings&) const = default;
+};
+
+// Must match the push_constant block of shaders/sdf.comp
+struct SdfPushConstants
+{
+  uint32_t pass;
+  int32_t  step;
+  float    threshold;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Signed distance field of an image on the GPU, with the jump flooding algorithm: a seed pass
+// marks the boundary pixels, ceil(log2(N)) flood passes with steps N/2, ..., 1 propagate the
+// closest seed between two images of seeds, and a resolve pass writes the signed distance into an
+// R32F interop texture. Each pass reads what the previous one wrote, behind a compute barrier.
+// OpenGL samples the distance to draw an anti-aliased outline of the shape.
+//
+class SdfPass
+{
+public:
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, const ComputePipelineCache& pipelineCache, uint32_t queueFamily)
+  {
+    m_device      = device;
+    m_queueFamily = queueFamily;
+    m_timer.init(device, physicalDevice, queueFamily);
+
+    // Set 0: seeds A -> B, set 1: seeds B -> A
+    m_descriptors.init(device);
+    m_descriptors.addBinding(0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.initLayout();
+    m_descriptors.initPool(2);
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(SdfPushConstants)};
+    m_descriptors.initPipeLayout(1, &pushConstants);
+
+    const SpirvShader               shader = makeSpirvShader("shaders/sdf_comp.spv", sdf_comp_spv);
+    VkPipelineShaderStageCreateInfo stage{.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                          .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                          .module = createShaderModule(m_device, shader),
+                                          .pName  = "main"};
+    VkComputePipelineCreateInfo pipelineInfo{.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                             .stage  = stage,
+                                             .layout = m_descriptors.getPipeLayout()};
+    m_pipeline = pipelineCache.createCompute(pipelineInfo, shader.filename);
+    vkDestroyShaderModule(m_device, stage.module, nullptr);
+  }
+
+  void deinit(nvvk::ResourceAllocator& alloc)
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+    destroyImages(alloc);
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    m_descriptors.deinit();
+    m_timer.deinit();
+    m_device = VK_NULL_HANDLE;
+  }
+
+  bool isValid() const { return m_device != VK_NULL_HANDLE; }
+
+  // (Re)creates the images of seeds and the distance texture, for images of `extent`. The previous
+  // submission using them must be complete.
+  void resize(nvvk::ResourceAllocator& alloc, VkExtent2D extent)
+  {
+    destroyImages(alloc);
+    m_extent = extent;
+
+    VkImageCreateInfo imageInfo{.sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                                .imageType   = VK_IMAGE_TYPE_2D,
+                                .format      = VK_FORMAT_R32_UINT,
+                                .extent      = {extent.width, extent.height, 1},
+                                .mipLevels   = 1,
+                                .arrayLayers = 1,
+                                .samples     = VK_SAMPLE_COUNT_1_BIT,
+                                .tiling      = VK_IMAGE_TILING_OPTIMAL,
+                                .usage       = VK_IMAGE_USAGE_STORAGE_BIT};
+    for(nvvk::Texture& seeds : m_seeds)
+    {
+      nvvk::Image           image  = alloc.createImage(imageInfo);
+      VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageInfo);
+      seeds                        = alloc.createTexture(image, ivInfo);
+    }
+    m_seedsReady = false;
+
+    imageInfo.format             = VK_FORMAT_R32_SFLOAT;
+    imageInfo.usage              = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    nvvk::Image           image  = alloc.createImage(imageInfo);
+    VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageInfo);
+    m_distance.texVk             = alloc.createTexture(image, ivInfo, {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO});
+    m_distance.imgSize           = extent;
+    createTextureGL(alloc, m_distance, GL_R32F, GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
+    m_state.init(m_distance.texVk.image, m_distance.oglId, VK_IMAGE_LAYOUT_UNDEFINED, m_queueFamily);
+
+    const VkDescriptorImageInfo seedsA{.imageView = m_seeds[0].descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkDescriptorImageInfo seedsB{.imageView = m_seeds[1].descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkDescriptorImageInfo distance{.imageView = m_distance.texVk.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkWriteDescriptorSet writes[6] = {m_descriptors.makeWrite(0, 1, &seedsA),   m_descriptors.makeWrite(0, 2, &seedsB),
+                                            m_descriptors.makeWrite(0, 3, &distance), m_descriptors.makeWrite(1, 1, &seedsB),
+                                            m_descriptors.makeWrite(1, 2, &seedsA),   m_descriptors.makeWrite(1, 3, &distance)};
+    vkUpdateDescriptorSets(m_device, 6, writes, 0, nullptr);
+  }
+
+  void destroyImages(nvvk::ResourceAllocator& alloc)
+  {
+    for(nvvk::Texture& seeds : m_seeds)
+    {
+      alloc.destroy(seeds);
+      seeds = {};
+    }
+    m_distance.destroy(alloc);
+    m_distance   = {};
+    m_sourceView = VK_NULL_HANDLE;
+  }
+
+  // OpenGL texture of the signed distance, in pixels, and its layout and owner for the interop batch
+  GLuint                   texture() const { return m_distance.oglId; }
+  nvvk::InteropImageState& state() { return m_state; }
+
+  // Step of the first flood pass: half the size rounded up to a power of two, so that the steps sum
+  // up to at least the size - 1 and a seed reaches every pixel
+  uint32_t firstStep() const { return std::bit_ceil(std::max(m_extent.width, m_extent.height)) / 2; }
+
+  // Number of flood passes for the size given to resize()
+  uint32_t floodPasses() const
+  {
+    uint32_t passes = 0;
+    for(uint32_t step = firstStep(); step > 0; step /= 2)
+      passes++;
+    return passes;
+  }
+
+  // Records the distance field of `sourceView`, an image in GENERAL written by compute shaders
+  // before, of the size given to resize()
+  void record(VkCommandBuffer cmd, VkImageView sourceView, const SdfSettings& settings)
+  {
+    if(sourceView != m_sourceView)
+    {
+      const VkDescriptorImageInfo source{.imageView = sourceView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+      const VkWriteDescriptorSet  writes[2] = {m_descriptors.makeWrite(0, 0, &source), m_descriptors.makeWrite(1, 0, &source)};
+      vkUpdateDescriptorSets(m_device, 2, writes, 0, nullptr);
+      m_sourceView = sourceView;
+    }
+
+    // The source is read once written, and the images of seeds get their layout once
+    VkImageMemoryBarrier initLayouts[2];
+    for(uint32_t i = 0; i < 2; i++)
+    {
+      initLayouts[i] = {.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                        .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                        .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
+                        .newLayout        = VK_IMAGE_LAYOUT_GENERAL,
+                        .image            = m_seeds[i].image,
+                        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+    }
+    VkMemoryBarrier writeToRead{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &writeToRead, 0, nullptr, m_seedsReady ? 0 : 2, initLayouts);
+    m_seedsReady = true;
+
+    m_timer.begin(cmd);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    SdfPushConstants pushc{.pass = 0, .step = 0, .threshold = settings.threshold};
+    // Seeds into A
+    dispatch(cmd, 1, pushc);
+    uint32_t current = 0;  // Image of seeds written last
+    for(uint32_t step = firstStep(); step > 0; step /= 2)
+    {
+      barrier(cmd);
+      pushc.pass = 1;
+      pushc.step = int32_t(step);
+      dispatch(cmd, current, pushc);
+      current ^= 1;
+    }
+    barrier(cmd);
+    m_state.acquireVk(cmd, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    pushc.pass = 2;
+    dispatch(cmd, current, pushc);
+    m_timer.end(cmd);
+    m_state.releaseVk(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+  }
+
+  // GPU time of the last distance field measured, negative if there is none
+  double lastGpuMs() const { return m_timer.lastMs(); }
+
+private:
+  // Between passes: the next one reads the seeds the previous one wrote, and writes the ones it read
+  static void barrier(VkCommandBuffer cmd)
+  {
+    VkMemoryBarrier barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  // Set 0 reads seeds A, set 1 reads seeds B
+  void dispatch(VkCommandBuffer cmd, uint32_t set, const SdfPushConstants& pushc)
+  {
+    const VkDescriptorSet descriptorSet = m_descriptors.getSet(set);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_descriptors.getPipeLayout(), 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cmd, m_descriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+    vkCmdDispatch(cmd, (m_extent.width + 15) / 16, (m_extent.height + 15) / 16, 1);
+  }
+
+  VkDevice                     m_device{};
+  uint32_t                     m_queueFamily{0};
+  nvvk::DescriptorSetContainer m_descriptors;
+  VkPipeline                   m_pipeline{};
+  VkExtent2D                   m_extent{0, 0};
+  nvvk::Texture                m_seeds[2];            // A and B, written in turns
+  bool                         m_seedsReady{false};   // In GENERAL
+  nvvk::Texture2DVkGL          m_distance;            // Sampled by OpenGL
+  nvvk::InteropImageState      m_state;               // Layout and owner of m_distance
+  VkImageView                  m_sourceView{};        // Of the descriptor sets
+  nvvk::GpuTimer               m_timer;
+};
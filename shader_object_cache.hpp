@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "nvh/nvprint.hpp"
+#include "nvvk/error_vk.hpp"
+
+namespace nvvk {
+
+//--------------------------------------------------------------------------------------------------
+// Creates compute shader objects (VK_EXT_shader_object) and keeps their binaries, obtained with
+// vkGetShaderBinaryDataEXT, by name and hash of the SPIR-V. Creating the same shader again then
+// skips the SPIR-V compilation. The binaries can be saved to and loaded from a file, which is only
+// reused on a device with the same shaderBinaryUUID and shaderBinaryVersion.
+//
+class ShaderObjectCache
+{
+public:
+  void init(VkDevice device, VkPhysicalDevice physicalDevice)
+  {
+    m_device = device;
+    VkPhysicalDeviceShaderObjectPropertiesEXT shaderObjectProperties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_PROPERTIES_EXT};
+    VkPhysicalDeviceProperties2 properties{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &shaderObjectProperties};
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    memcpy(m_binaryUUID, shaderObjectProperties.shaderBinaryUUID, VK_UUID_SIZE);
+    m_binaryVersion = shaderObjectProperties.shaderBinaryVersion;
+  }
+
+  bool isValid() const { return m_device != VK_NULL_HANDLE; }
+
+  // Compute shader object named `name`, from its cached binary when there is one, otherwise from
+  // the SPIR-V. `useCache` false bypasses the cache, e.g. for SPIR-V reloaded from disk.
+  VkShaderEXT createCompute(const std::string&           name,
+                            const uint32_t*              spirv,
+                            size_t                       spirvSize,
+                            uint32_t                     setLayoutCount,
+                            const VkDescriptorSetLayout* setLayouts,
+                            const VkPushConstantRange&   pushConstants,
+                            bool                         useCache = true)
+  {
+    VkShaderCreateInfoEXT createInfo{.sType                  = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+                                     .stage                  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                     .codeType               = VK_SHADER_CODE_TYPE_SPIRV_EXT,
+                                     .codeSize               = spirvSize,
+                                     .pCode                  = spirv,
+                                     .pName                  = "main",
+                                     .setLayoutCount         = setLayoutCount,
+                                     .pSetLayouts            = setLayouts,
+                                     .pushConstantRangeCount = 1,
+                                     .pPushConstantRanges    = &pushConstants};
+    VkShaderEXT shader{};
+
+    // The same name with another SPIR-V, e.g. after a rebuild, must not get the old binary
+    const std::string key = name + "#" + std::to_string(hashSpirv(spirv, spirvSize));
+    auto              it  = useCache ? m_binaries.find(key) : m_binaries.end();
+    if(it != m_binaries.end())
+    {
+      VkShaderCreateInfoEXT binaryInfo = createInfo;
+      binaryInfo.codeType              = VK_SHADER_CODE_TYPE_BINARY_EXT;
+      binaryInfo.codeSize              = it->second.size();
+      binaryInfo.pCode                 = it->second.data();
+      // A binary from another driver version is rejected, then the SPIR-V is used
+      if(vkCreateShadersEXT(m_device, 1, &binaryInfo, nullptr, &shader) == VK_SUCCESS)
+      {
+        m_hits++;
+        return shader;
+      }
+      m_binaries.erase(it);
+    }
+
+    m_misses++;
+    NVVK_CHECK(vkCreateShadersEXT(m_device, 1, &createInfo, nullptr, &shader));
+    size_t binarySize = 0;
+    if(useCache && vkGetShaderBinaryDataEXT(m_device, shader, &binarySize, nullptr) == VK_SUCCESS && binarySize > 0)
+    {
+      std::vector<uint8_t> binary(binarySize);
+      if(vkGetShaderBinaryDataEXT(m_device, shader, &binarySize, binary.data()) == VK_SUCCESS)
+        m_binaries[key] = std::move(binary);
+    }
+    return shader;
+  }
+
+  // File layout: UUID, version, count, then per binary: name size, name, data size, data
+  void save(const std::string& filename) const
+  {
+    std::ofstream file(filename, std::ios::binary);
+    if(!file)
+      return;
+    const uint32_t count = uint32_t(m_binaries.size());
+    file.write(reinterpret_cast<const char*>(m_binaryUUID), VK_UUID_SIZE);
+    file.write(reinterpret_cast<const char*>(&m_binaryVersion), sizeof(m_binaryVersion));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for(const auto& [name, binary] : m_binaries)
+    {
+      const uint64_t nameSize = name.size();
+      const uint64_t dataSize = binary.size();
+      file.write(reinterpret_cast<const char*>(&nameSize), sizeof(nameSize));
+      file.write(name.data(), std::streamsize(nameSize));
+      file.write(reinterpret_cast<const char*>(&dataSize), sizeof(dataSize));
+      file.write(reinterpret_cast<const char*>(binary.data()), std::streamsize(dataSize));
+    }
+  }
+
+  // Returns false when there is no file, or when it is for another device or driver
+  bool load(const std::string& filename)
+  {
+    std::ifstream file(filename, std::ios::binary);
+    if(!file)
+      return false;
+    uint8_t  uuid[VK_UUID_SIZE];
+    uint32_t version = 0;
+    uint32_t count   = 0;
+    file.read(reinterpret_cast<char*>(uuid), VK_UUID_SIZE);
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if(!file || memcmp(uuid, m_binaryUUID, VK_UUID_SIZE) != 0 || version != m_binaryVersion)
+    {
+      LOGI("Shader object cache %s is for another device or driver, ignored\n", filename.c_str());
+      return false;
+    }
+    for(uint32_t i = 0; i < count; i++)
+    {
+      uint64_t nameSize = 0;
+      uint64_t dataSize = 0;
+      file.read(reinterpret_cast<char*>(&nameSize), sizeof(nameSize));
+      if(!file || nameSize > kMaxNameSize)
+        return false;
+      std::string name(nameSize, '\0');
+      file.read(name.data(), std::streamsize(nameSize));
+      file.read(reinterpret_cast<char*>(&dataSize), sizeof(dataSize));
+      if(!file || dataSize > kMaxBinarySize)
+        return false;
+      std::vector<uint8_t> binary(dataSize);
+      file.read(reinterpret_cast<char*>(binary.data()), std::streamsize(dataSize));
+      if(!file)
+        return false;
+      m_binaries[name] = std::move(binary);
+    }
+    return true;
+  }
+
+  size_t   size() const { return m_binaries.size(); }
+  uint32_t hits() const { return m_hits; }      // Shaders created from a cached binary
+  uint32_t misses() const { return m_misses; }  // Shaders compiled from SPIR-V
+
+private:
+  // FNV-1a of the SPIR-V words
+  static uint64_t hashSpirv(const uint32_t* spirv, size_t spirvSize)
+  {
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < spirvSize / sizeof(uint32_t); i++)
+      hash = (hash ^ spirv[i]) * 1099511628211ull;
+    return hash;
+  }
+
+  // Bounds for reading a damaged file
+  static constexpr uint64_t kMaxNameSize   = 4096;
+  static constexpr uint64_t kMaxBinarySize = 64 << 20;
+
+  VkDevice                                              m_device{};
+  uint8_t                                               m_binaryUUID[VK_UUID_SIZE]{};
+  uint32_t                                              m_binaryVersion{0};
+  std::unordered_map<std::string, std::vector<uint8_t>> m_binaries;
+  uint32_t                                              m_hits{0};
+  uint32_t                                              m_misses{0};
+};
+
+}  // namespace nvvk
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "nvh/fileoperations.hpp"
+#include "nvh/nvprint.hpp"
+#include "nvvk/error_vk.hpp"
+
+extern std::vector<std::string> defaultSearchPaths;
+
+//--------------------------------------------------------------------------------------------------
+// SPIR-V shader embedded in the executable by the build (see _embed_SPV in CMakeLists.txt).
+// The file it was built from can be reloaded from disk instead, to iterate on shaders without
+// restarting.
+//
+struct SpirvShader
+{
+  const char*     filename;  // .spv file, searched in defaultSearchPaths when reloading
+  const uint32_t* code;
+  size_t          size;  // In bytes
+};
+
+template <size_t N>
+constexpr SpirvShader makeSpirvShader(const char* filename, const uint32_t (&code)[N])
+{
+  return {filename, code, N * sizeof(uint32_t)};
+}
+
+// Entry of a variant table generated by _compile_GLSL_variants in CMakeLists.txt
+struct ComputeShaderVariant
+{
+  VkFormat    format;         // FORMAT
+  uint32_t    workgroupSize;  // WORKGROUP_SIZE
+  bool        fp16;           // FP16
+  bool        bindless;       // BINDLESS
+  SpirvShader shader;
+};
+
+// The embedded code, or the file's when `fromDisk` is set and it is found. `fileCode` holds the file.
+inline SpirvShader loadSpirv(const SpirvShader& shader, bool fromDisk, std::string& fileCode)
+{
+  if(!fromDisk)
+    return shader;
+  fileCode = nvh::loadFile(shader.filename, true, defaultSearchPaths);
+  if(fileCode.empty() || fileCode.size() % sizeof(uint32_t) != 0)
+  {
+    LOGW("Could not load %s, using the embedded SPIR-V\n", shader.filename);
+    return shader;
+  }
+  return {shader.filename, reinterpret_cast<const uint32_t*>(fileCode.data()), fileCode.size()};
+}
+
+inline VkShaderModule createShaderModule(VkDevice device, const SpirvShader& shader, bool fromDisk = false)
+{
+  std::string       fileCode;
+  const SpirvShader spirv = loadSpirv(shader, fromDisk, fileCode);
+
+  VkShaderModuleCreateInfo createInfo{.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, .codeSize = spirv.size, .pCode = spirv.code};
+  VkShaderModule shaderModule{};
+  NVVK_CHECK(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
+  return shaderModule;
+}
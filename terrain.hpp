@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include "gl_vk.hpp"
+#include "gpu_timer.hpp"
+#include "interop_registry.hpp"
+#include "pipeline_cache.hpp"
+#include "spirv.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
+#include "nvvk/images_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "terrain_comp_spv.h"
+
+struct TerrainSettings
+{
+  bool     enabled{false};
+  uint32_t resolution{1024};    // Texels per side of the heightfield, a multiple of kPatchSize
+  float    heightScale{0.2f};   // Height of the terrain for a height of 1, in units of its side
+  float    pixelsPerEdge{8.f};  // Target length of the tessellated edges on screen, in pixels
+  bool     wireframe{false};
+
+  bool operator==(const TerrainSettings&) const = default;
+};
+
+// Must match the push_constant block of shaders/terrain.comp
+struct TerrainPushConstants
+{
+  uint32_t pass;
+  float    time;
+  float    heightScale;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Procedural terrain generated by Vulkan each frame and drawn by OpenGL:
+// - an R32F heightfield and an RGBA16F normal map, interop images OpenGL samples
+// - a grid of patches of kPatchSize^2 texels in an interop buffer, one vec4 per patch (origin in
+//   UV, range of heights), which OpenGL draws as GL_PATCHES of one vertex: the bounds let the
+//   tessellation cull patches outside the view, and the origin places the tessellated vertices
+// It has its own submission and semaphores, registered next to the producers'.
+//
+class TerrainVk
+{
+public:
+  static constexpr uint32_t kPatchSize = 16;  // PATCH_SIZE of the shader
+
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, const ComputePipelineCache& pipelineCache, nvvk::ResourceAllocator& alloc, uint32_t queueFamily)
+  {
+    m_device      = device;
+    m_alloc       = &alloc;
+    m_queueFamily = queueFamily;
+    vkGetDeviceQueue(device, queueFamily, 0, &m_queue);
+
+    VkCommandPoolCreateInfo poolInfo{.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                                     .flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                                     .queueFamilyIndex = queueFamily};
+    NVVK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &m_commandPool));
+    VkCommandBufferAllocateInfo allocateInfo{.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                                             .commandPool        = m_commandPool,
+                                             .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                                             .commandBufferCount = 1};
+    NVVK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &m_commandBuffer));
+    VkFenceCreateInfo fenceInfo{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .flags = VK_FENCE_CREATE_SIGNALED_BIT};
+    NVVK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &m_fence));
+    m_semaphores.create(device);
+    m_timer.init(device, physicalDevice, queueFamily);
+
+    m_descriptors.init(device);
+    m_descriptors.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.initLayout();
+    m_descriptors.initPool(1);
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(TerrainPushConstants)};
+    m_descriptors.initPipeLayout(1, &pushConstants);
+
+    const SpirvShader               shader = makeSpirvShader("shaders/terrain_comp.spv", terrain_comp_spv);
+    VkPipelineShaderStageCreateInfo stage{.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                          .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                          .module = createShaderModule(m_device, shader),
+                                          .pName  = "main"};
+    VkComputePipelineCreateInfo pipelineInfo{.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                             .stage  = stage,
+                                             .layout = m_descriptors.getPipeLayout()};
+    m_pipeline = pipelineCache.createCompute(pipelineInfo, shader.filename);
+    vkDestroyShaderModule(m_device, stage.module, nullptr);
+  }
+
+  void deinit()
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    destroyResources();
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    m_descriptors.deinit();
+    m_timer.deinit();
+    m_semaphores.destroy(m_device);
+    vkDestroyFence(m_device, m_fence, nullptr);
+    vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+    m_device = VK_NULL_HANDLE;
+  }
+
+  bool isValid() const { return m_device != VK_NULL_HANDLE; }
+
+  // (Re)creates the heightfield, normal map and patches for `resolution` texels per side
+  void resize(uint32_t resolution)
+  {
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    destroyResources();
+    m_resolution = resolution;
+
+    for(Texture* texture : {&m_height, &m_normal})
+    {
+      const bool        isHeight = texture == &m_height;
+      VkImageCreateInfo imageInfo{.sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                                  .imageType   = VK_IMAGE_TYPE_2D,
+                                  .format      = isHeight ? VK_FORMAT_R32_SFLOAT : VK_FORMAT_R16G16B16A16_SFLOAT,
+                                  .extent      = {resolution, resolution, 1},
+                                  .mipLevels   = 1,
+                                  .arrayLayers = 1,
+                                  .samples     = VK_SAMPLE_COUNT_1_BIT,
+                                  .tiling      = VK_IMAGE_TILING_OPTIMAL,
+                                  .usage       = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT};
+      nvvk::Image           image  = m_alloc->createImage(imageInfo);
+      VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageInfo);
+      texture->image.texVk         = m_alloc->createTexture(image, ivInfo, {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO});
+      texture->image.imgSize       = {resolution, resolution};
+      createTextureGL(*m_alloc, texture->image, isHeight ? GL_R32F : GL_RGBA16F, GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
+      texture->state.init(texture->image.texVk.image, texture->image.oglId, VK_IMAGE_LAYOUT_UNDEFINED, m_queueFamily);
+    }
+    m_patches.bufVk = m_alloc->createBuffer(VkDeviceSize(patchCount()) * 4 * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createBufferGL(*m_alloc, m_patches);
+
+    const VkDescriptorImageInfo  height{.imageView = m_height.image.texVk.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkDescriptorImageInfo  normal{.imageView = m_normal.image.texVk.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkDescriptorBufferInfo patches{m_patches.bufVk.buffer, 0, VK_WHOLE_SIZE};
+    const VkWriteDescriptorSet   writes[3] = {m_descriptors.makeWrite(0, 0, &height), m_descriptors.makeWrite(0, 1, &normal),
+                                              m_descriptors.makeWrite(0, 2, &patches)};
+    vkUpdateDescriptorSets(m_device, 3, writes, 0, nullptr);
+  }
+
+  uint32_t resolution() const { return m_resolution; }
+  uint32_t patchesPerSide() const { return m_resolution / kPatchSize; }
+  uint32_t patchCount() const { return patchesPerSide() * patchesPerSide(); }
+
+  // OpenGL objects: R32F heights, RGBA16F normals, and the patches as vec4 vertices
+  GLuint heightTexture() const { return m_height.image.oglId; }
+  GLuint normalTexture() const { return m_normal.image.oglId; }
+  GLuint patchBuffer() const { return m_patches.oglId; }
+
+  // GPU time of the last generation, negative if there is none
+  double lastGpuMs() const { return m_timer.lastMs(); }
+
+  // Adds the interop resources of the next submission to the frame's registry
+  void registerInterop(nvvk::InteropRegistry& registry)
+  {
+    nvvk::InteropBatch& batch = registry.batch(m_semaphores.glReady, m_semaphores.glComplete);
+    batch.addTexture(m_height.state, VK_IMAGE_LAYOUT_GENERAL);
+    batch.addTexture(m_normal.state, VK_IMAGE_LAYOUT_GENERAL);
+    batch.addBuffer(m_patches.oglId);
+  }
+
+  // `time` is the animation time in seconds
+  void buildCommandBuffer(float time, const TerrainSettings& settings)
+  {
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    NVVK_CHECK(vkResetFences(m_device, 1, &m_fence));
+
+    VkCommandBufferBeginInfo beginInfo{.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                                       .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+    NVVK_CHECK(vkBeginCommandBuffer(m_commandBuffer, &beginInfo));
+    m_height.state.acquireVk(m_commandBuffer, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    m_normal.state.acquireVk(m_commandBuffer, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_ACCESS_SHADER_WRITE_BIT);
+
+    m_timer.begin(m_commandBuffer);
+    const VkDescriptorSet set = m_descriptors.getSet(0);
+    vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(m_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_descriptors.getPipeLayout(), 0, 1, &set, 0, nullptr);
+    TerrainPushConstants pushc{.pass = 0, .time = time, .heightScale = settings.heightScale};
+    vkCmdPushConstants(m_commandBuffer, m_descriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+    vkCmdDispatch(m_commandBuffer, patchesPerSide(), patchesPerSide(), 1);
+
+    // The normals and bounds read the neighbors' heights
+    VkMemoryBarrier barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
+    vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+    pushc.pass = 1;
+    vkCmdPushConstants(m_commandBuffer, m_descriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+    vkCmdDispatch(m_commandBuffer, patchesPerSide(), patchesPerSide(), 1);
+    m_timer.end(m_commandBuffer);
+
+    m_height.state.releaseVk(m_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    m_normal.state.releaseVk(m_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    NVVK_CHECK(vkEndCommandBuffer(m_commandBuffer));
+  }
+
+  // Waits for OpenGL to hand the resources over, and signals when they are written
+  void submit()
+  {
+    const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkSubmitInfo               submitInfo{.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                                          .waitSemaphoreCount   = 1,
+                                          .pWaitSemaphores      = &m_semaphores.vkReady,
+                                          .pWaitDstStageMask    = &waitStage,
+                                          .commandBufferCount   = 1,
+                                          .pCommandBuffers      = &m_commandBuffer,
+                                          .signalSemaphoreCount = 1,
+                                          .pSignalSemaphores    = &m_semaphores.vkComplete};
+    NVVK_CHECK(vkQueueSubmit(m_queue, 1, &submitInfo, m_fence));
+  }
+
+private:
+  struct Texture
+  {
+    nvvk::Texture2DVkGL     image;
+    nvvk::InteropImageState state;
+  };
+
+  void destroyResources()
+  {
+    if(m_resolution == 0)
+      return;
+    m_height.image.destroy(*m_alloc);
+    m_normal.image.destroy(*m_alloc);
+    m_patches.destroy(*m_alloc);
+    m_height     = {};
+    m_normal     = {};
+    m_patches    = {};
+    m_resolution = 0;
+  }
+
+  VkDevice                     m_device{};
+  nvvk::ResourceAllocator*     m_alloc{nullptr};
+  uint32_t                     m_queueFamily{0};
+  VkQueue                      m_queue{};
+  VkCommandPool                m_commandPool{};
+  VkCommandBuffer              m_commandBuffer{};
+  VkFence                      m_fence{};
+  nvvk::InteropSemaphores      m_semaphores;
+  nvvk::DescriptorSetContainer m_descriptors;
+  VkPipeline                   m_pipeline{};
+  nvvk::GpuTimer               m_timer;
+  uint32_t                     m_resolution{0};
+  Texture                      m_height;   // R32F, in [0, 1]
+  Texture                      m_normal;   // RGBA16F, normal in xyz
+  nvvk::BufferVkGL             m_patches;  // vec4 per patch, rows of patchesPerSide()
+};
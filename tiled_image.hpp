@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "compute.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// Logical image made of a grid of interop textures.
+// Each tile is a ComputeImageVk of at most maxTileDimension() pixels per side, which computes its
+// own part of the logical image. This allows images larger than maxImageDimension2D.
+//
+class TiledImageVk
+{
+public:
+  void setup(const VkDevice&                         device,
+             const VkPhysicalDevice&                 physicalDevice,
+             uint32_t                                queueIdxGraphic,
+             uint32_t                                queueIdxCompute,
+             uint32_t                                queueIndex,
+             nvvk::ExportResourceAllocatorDedicated& alloc,
+             const ComputeFeatures&                  features)
+  {
+    m_features        = features;
+    m_device          = device;
+    m_physicalDevice  = physicalDevice;
+    m_queueIdxGraphic = queueIdxGraphic;
+    m_queueIdxCompute = queueIdxCompute;
+    m_queueIndex      = queueIndex;
+    m_alloc           = &alloc;
+
+    // A tile must fit both APIs
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    m_deviceMaxTileDimension = std::min(properties.limits.maxImageDimension2D, uint32_t(maxTextureSize));
+    m_maxTileDimension       = m_deviceMaxTileDimension;
+  }
+
+  void destroy()
+  {
+    for(auto& tile : m_tiles)
+      tile->destroy();
+    m_tiles.clear();
+  }
+
+  void setQueue(uint32_t queueIndex)
+  {
+    m_queueIndex = queueIndex;
+    for(auto& tile : m_tiles)
+      tile->setQueue(queueIndex);
+  }
+
+  void setParams(const KernelParams& params)
+  {
+    m_params = params;
+    for(auto& tile : m_tiles)
+      tile->m_params = params;
+  }
+
+  // Must be set before update() when ComputeFeatures::bindless or shaderObject are used
+  void setSharedResources(const ComputeSharedResources& shared) { m_shared = shared; }
+
+  // Variant of shader.comp for all tiles, see ComputeImageVk::setVariant(). nullptr selects the best one.
+  void setVariant(const ComputeShaderVariant* variant)
+  {
+    m_variant = variant;
+    if(variant)
+    {
+      for(auto& tile : m_tiles)
+        tile->setVariant(*variant);
+    }
+  }
+
+  // Ping-pong iterations per frame of all tiles, see ComputeImageVk::setIterations()
+  void setIterations(uint32_t iterations)
+  {
+    m_iterations = iterations;
+    for(auto& tile : m_tiles)
+      tile->setIterations(iterations);
+  }
+
+  // Blur of all tiles, see ComputeImageVk::setBlur(). Each tile is blurred on its own.
+  void setBlur(const BlurSettings& settings)
+  {
+    m_blur = settings;
+    for(auto& tile : m_tiles)
+      tile->setBlur(settings);
+  }
+
+  // Automatic exposure of all tiles, see ComputeImageVk::setExposure(). Each tile has its own.
+  void setExposure(const ExposureSettings& settings)
+  {
+    m_exposure = settings;
+    for(auto& tile : m_tiles)
+      tile->setExposure(settings);
+  }
+
+  // RGBA16F tiles, see ComputeImageVk::setHdr(). Resets the variant of shader.comp to the best one.
+  void setHdr(bool hdr)
+  {
+    m_hdr     = hdr;
+    m_variant = nullptr;
+    for(auto& tile : m_tiles)
+      tile->setHdr(hdr);
+  }
+
+  void setToneMapping(const ToneMapSettings& settings)
+  {
+    m_toneMapping = settings;
+    for(auto& tile : m_tiles)
+      tile->setToneMapping(settings);
+  }
+
+  // BC compression of all tiles, see ComputeImageVk::setBlockCompression()
+  void setBlockCompression(const BlockCompressSettings& settings)
+  {
+    m_compression = settings;
+    for(auto& tile : m_tiles)
+      tile->setBlockCompression(settings);
+  }
+
+  // Signed distance field of all tiles, see ComputeImageVk::setSdf(). Each tile has its own, so
+  // distances do not cross tile borders.
+  void setSdf(const SdfSettings& settings)
+  {
+    m_sdf = settings;
+    for(auto& tile : m_tiles)
+      tile->setSdf(settings);
+  }
+
+  void reloadShaders()
+  {
+    for(auto& tile : m_tiles)
+      tile->reloadShaders();
+  }
+
+  // Limit the tile size below the device limit, mostly to exercise tiling at small sizes.
+  // 0 selects the device limit.
+  void setMaxTileDimension(uint32_t maxTileDimension)
+  {
+    m_maxTileDimension =
+        maxTileDimension == 0 ? m_deviceMaxTileDimension : std::clamp(maxTileDimension, 1u, m_deviceMaxTileDimension);
+    if(m_extent.width != 0)
+      update(m_extent);
+  }
+
+  // Use sparse-resident tiles (support must be valid) or regular ones (nullptr)
+  void setSparse(const nvvk::SparseInteropSupport* sparse)
+  {
+    m_sparse = sparse;
+    for(auto& tile : m_tiles)
+    {
+      tile->setSparse(sparse);
+      tile->update(tile->m_textureTarget.imgSize);
+    }
+  }
+
+  // Visible part of the logical image in UV: offset (x, y) and size (z, w). Each tile only computes,
+  // and for sparse tiles only keeps resident, the pixels in that region.
+  void setVisibleRegion(const std::array<float, 4>& uvRect)
+  {
+    for(auto& tile : m_tiles)
+    {
+      // One extra pixel on each side for bilinear filtering
+      const int32_t x0 = int32_t(floorf(uvRect[0] * float(m_extent.width))) - tile->m_tileOffset.x - 1;
+      const int32_t y0 = int32_t(floorf(uvRect[1] * float(m_extent.height))) - tile->m_tileOffset.y - 1;
+      const int32_t x1 = int32_t(ceilf((uvRect[0] + uvRect[2]) * float(m_extent.width))) - tile->m_tileOffset.x + 1;
+      const int32_t y1 = int32_t(ceilf((uvRect[1] + uvRect[3]) * float(m_extent.height))) - tile->m_tileOffset.y + 1;
+      const VkExtent2D size = tile->m_textureTarget.imgSize;
+      const int32_t    cx0  = std::clamp(x0, 0, int32_t(size.width));
+      const int32_t    cy0  = std::clamp(y0, 0, int32_t(size.height));
+      const int32_t    cx1  = std::clamp(x1, cx0, int32_t(size.width));
+      const int32_t    cy1  = std::clamp(y1, cy0, int32_t(size.height));
+      tile->setVisibleRegion({{cx0, cy0}, {uint32_t(cx1 - cx0), uint32_t(cy1 - cy0)}});
+    }
+  }
+
+  uint32_t maxTileDimension() const { return m_maxTileDimension; }
+  uint32_t deviceMaxTileDimension() const { return m_deviceMaxTileDimension; }
+
+  // (Re)create the tiles for a logical image of the given size
+  void update(VkExtent2D extent)
+  {
+    m_extent   = extent;
+    m_columns  = (extent.width + m_maxTileDimension - 1) / m_maxTileDimension;
+    m_rows     = (extent.height + m_maxTileDimension - 1) / m_maxTileDimension;
+    m_tileSize = {(extent.width + m_columns - 1) / m_columns, (extent.height + m_rows - 1) / m_rows};
+
+    const size_t tileCount = size_t(m_columns) * m_rows;
+    while(m_tiles.size() > tileCount)
+    {
+      m_tiles.back()->destroy();
+      m_tiles.pop_back();
+    }
+    while(m_tiles.size() < tileCount)
+    {
+      ComputeImageVk& tile = *m_tiles.emplace_back(std::make_unique<ComputeImageVk>());
+      tile.setSharedResources(m_shared);
+      tile.setup(m_device, m_physicalDevice, m_queueIdxGraphic, m_queueIdxCompute, m_queueIndex, *m_alloc, m_features);
+      tile.m_params = m_params;
+      tile.setHdr(m_hdr);
+      tile.setToneMapping(m_toneMapping);
+      tile.setSparse(m_sparse);
+      tile.setIterations(m_iterations);
+      tile.setBlur(m_blur);
+      tile.setExposure(m_exposure);
+      tile.setBlockCompression(m_compression);
+      tile.setSdf(m_sdf);
+      if(m_variant)
+        tile.setVariant(*m_variant);
+    }
+
+    for(uint32_t row = 0; row < m_rows; row++)
+    {
+      for(uint32_t col = 0; col < m_columns; col++)
+      {
+        ComputeImageVk& tile = *m_tiles[row * m_columns + col];
+        tile.m_tileOffset    = {int32_t(col * m_tileSize.width), int32_t(row * m_tileSize.height)};
+        tile.m_logicalSize   = extent;
+        // The last column and row get what remains
+        const VkExtent2D size = {std::min(m_tileSize.width, extent.width - col * m_tileSize.width),
+                                 std::min(m_tileSize.height, extent.height - row * m_tileSize.height)};
+        if(0 != memcmp(&size, &tile.m_textureTarget.imgSize, sizeof(VkExtent2D)))
+          tile.update(size);
+      }
+    }
+  }
+
+  // Region covered by a tile, in UV of the logical image: offset (x, y) and size (z, w)
+  std::array<float, 4> tileRect(uint32_t tileIndex) const
+  {
+    const ComputeImageVk& tile = *m_tiles[tileIndex];
+    return {float(tile.m_tileOffset.x) / float(m_extent.width), float(tile.m_tileOffset.y) / float(m_extent.height),
+            float(tile.m_textureTarget.imgSize.width) / float(m_extent.width),
+            float(tile.m_textureTarget.imgSize.height) / float(m_extent.height)};
+  }
+
+  bool isTiled() const { return m_tiles.size() > 1; }
+
+  std::vector<std::unique_ptr<ComputeImageVk>> m_tiles;           // Not movable, hence not held by value
+  VkExtent2D                                   m_extent{0, 0};    // Size of the logical image
+  VkExtent2D                                   m_tileSize{0, 0};  // Size of all tiles, except the last row and column
+  uint32_t                                     m_columns{0};
+  uint32_t                                     m_rows{0};
+
+private:
+  VkDevice                                m_device{};
+  VkPhysicalDevice                        m_physicalDevice{};
+  uint32_t                                m_queueIdxGraphic{};
+  uint32_t                                m_queueIdxCompute{};
+  uint32_t                                m_queueIndex{};
+  nvvk::ExportResourceAllocatorDedicated* m_alloc = nullptr;
+  KernelParams                            m_params;
+  ComputeFeatures                         m_features;
+  ComputeSharedResources                  m_shared;
+  const ComputeShaderVariant*             m_variant = nullptr;
+  const nvvk::SparseInteropSupport*       m_sparse = nullptr;
+  uint32_t                                m_iterations{0};
+  BlurSettings                            m_blur;
+  ExposureSettings                        m_exposure;
+  bool                                    m_hdr{false};
+  ToneMapSettings                         m_toneMapping;
+  BlockCompressSettings                   m_compression;
+  SdfSettings                             m_sdf;
+  uint32_t                                m_maxTileDimension{0};
+  uint32_t                                m_deviceMaxTileDimension{0};
+};
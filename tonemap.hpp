@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include "pipeline_cache.hpp"
+#include "spirv.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
+
+#include "tonemap_comp_spv.h"
+
+// Tone mapping of the HDR (RGBA16F) interop images
+struct ToneMapSettings
+{
+  enum Operator : int
+  {
+    eClamp,
+    eReinhard,  // Extended, with the white point
+    eAces,      // Narkowicz's fit of the ACES filmic curve
+    eHable,     // Uncharted 2 filmic curve, with the white point
+  };
+
+  enum Location : int
+  {
+    eDisplay,  // In the OpenGL present shader, when sampling the image
+    eCompute,  // In a compute pass after the kernel, see ToneMapPass
+  };
+
+  Operator op{eAces};
+  Location location{eDisplay};
+  float    whitePoint{4.0f};
+
+  bool operator==(const ToneMapSettings&) const = default;
+};
+
+// Must match the push_constant block of shaders/tonemap.comp
+struct ToneMapPushConstants
+{
+  uint32_t op;
+  float    whitePoint;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Tone mapping of an RGBA16F storage image in place. OpenGL then displays the result as is. This
+// costs a full-screen pass reading and writing the image, which tone mapping in the present shader
+// avoids; it is kept to measure that trade-off.
+//
+class ToneMapPass
+{
+public:
+  void init(VkDevice device, const ComputePipelineCache& pipelineCache)
+  {
+    m_device = device;
+    m_descriptors.init(device);
+    m_descriptors.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.initLayout();
+    m_descriptors.initPool(1);
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(ToneMapPushConstants)};
+    m_descriptors.initPipeLayout(1, &pushConstants);
+
+    const SpirvShader               shader = makeSpirvShader("shaders/tonemap_comp.spv", tonemap_comp_spv);
+    VkPipelineShaderStageCreateInfo stage{.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                          .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                          .module = createShaderModule(m_device, shader),
+                                          .pName  = "main"};
+    VkComputePipelineCreateInfo pipelineInfo{.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                             .stage  = stage,
+                                             .layout = m_descriptors.getPipeLayout()};
+    m_pipeline = pipelineCache.createCompute(pipelineInfo, shader.filename);
+    vkDestroyShaderModule(m_device, stage.module, nullptr);
+  }
+
+  void deinit()
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    m_descriptors.deinit();
+    m_device     = VK_NULL_HANDLE;
+    m_targetView = VK_NULL_HANDLE;
+  }
+
+  bool isValid() const { return m_device != VK_NULL_HANDLE; }
+
+  // The target image was recreated: a new view can have the handle of the destroyed one
+  void invalidate() { m_targetView = VK_NULL_HANDLE; }
+
+  // Records the tone mapping of `targetView`, in GENERAL and written by compute shaders before
+  void record(VkCommandBuffer cmd, VkImageView targetView, VkExtent2D extent, const ToneMapSettings& settings)
+  {
+    if(targetView != m_targetView)
+    {
+      const VkDescriptorImageInfo target{.imageView = targetView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+      const VkWriteDescriptorSet  write = m_descriptors.makeWrite(0, 0, &target);
+      vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+      m_targetView = targetView;
+    }
+
+    VkMemoryBarrier writeToRead{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &writeToRead, 0, nullptr, 0, nullptr);
+
+    const ToneMapPushConstants pushc{.op = uint32_t(settings.op), .whitePoint = settings.whitePoint};
+    const VkDescriptorSet      descriptorSet = m_descriptors.getSet(0);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_descriptors.getPipeLayout(), 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cmd, m_descriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+    vkCmdDispatch(cmd, (extent.width + 15) / 16, (extent.height + 15) / 16, 1);
+  }
+
+private:
+  VkDevice                     m_device{};
+  nvvk::DescriptorSetContainer m_descriptors;
+  VkPipeline                   m_pipeline{};
+  VkImageView                  m_targetView{};  // Of the descriptor set
+};
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "gl_vk.hpp"
+#include "gpu_timer.hpp"
+#include "interop_registry.hpp"
+#include "pipeline_cache.hpp"
+#include "spirv.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
+#include "nvvk/images_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+
+#include "volume_comp_spv.h"
+
+struct VolumeSettings
+{
+  bool     enabled{false};
+  uint32_t resolution{256};      // Voxels per side, a multiple of VolumeVk::kBrickSize
+  float    updateFraction{1.f};  // Part of the bricks computed each frame, the others keep their content
+  float    threshold{0.05f};     // Densities below are empty
+  float    densityScale{40.f};   // Extinction for a density of 1, per side of the volume
+  bool     skipEmpty{true};      // Empty-space skipping in the ray marching
+  bool     showSteps{false};     // Display the number of steps per pixel instead
+
+  bool operator==(const VolumeSettings&) const = default;
+};
+
+// Must match the push_constant block of shaders/volume.comp
+struct VolumePushConstants
+{
+  uint32_t pass;
+  uint32_t firstBrick;
+  uint32_t brickCount;  // Bricks of the dispatch
+  float    time;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Animated density volume simulated by Vulkan and ray-marched by OpenGL, without copies: the R16F
+// 3D image is a Texture3DVkGL, which OpenGL samples as a GL_TEXTURE_3D.
+// The volume is made of bricks of kBrickSize^3 voxels, each computed by a workgroup. A frame can
+// update only part of them, round-robin, the others keeping their content. Each brick also gets its
+// maximum density, dilated to its neighbors in an occupancy grid (another interop 3D image, one
+// texel per brick): a brick whose occupancy is below the threshold only has empty voxels around
+// it, so the ray marching jumps over it, even with trilinear filtering.
+// It has its own submission and semaphores, registered next to the producers'.
+//
+class VolumeVk
+{
+public:
+  static constexpr uint32_t kBrickSize = 8;  // BRICK_SIZE of the shader
+
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, const ComputePipelineCache& pipelineCache, nvvk::ResourceAllocator& alloc, uint32_t queueFamily)
+  {
+    m_device      = device;
+    m_alloc       = &alloc;
+    m_queueFamily = queueFamily;
+    vkGetDeviceQueue(device, queueFamily, 0, &m_queue);
+
+    VkCommandPoolCreateInfo poolInfo{.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                                     .flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                                     .queueFamilyIndex = queueFamily};
+    NVVK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &m_commandPool));
+    VkCommandBufferAllocateInfo allocateInfo{.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                                             .commandPool        = m_commandPool,
+                                             .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                                             .commandBufferCount = 1};
+    NVVK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &m_commandBuffer));
+    VkFenceCreateInfo fenceInfo{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .flags = VK_FENCE_CREATE_SIGNALED_BIT};
+    NVVK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &m_fence));
+    m_semaphores.create(device);
+    m_timer.init(device, physicalDevice, queueFamily);
+
+    m_descriptors.init(device);
+    m_descriptors.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    m_descriptors.initLayout();
+    m_descriptors.initPool(1);
+    VkPushConstantRange pushConstants{.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(VolumePushConstants)};
+    m_descriptors.initPipeLayout(1, &pushConstants);
+
+    const SpirvShader               shader = makeSpirvShader("shaders/volume_comp.spv", volume_comp_spv);
+    VkPipelineShaderStageCreateInfo stage{.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                                          .stage  = VK_SHADER_STAGE_COMPUTE_BIT,
+                                          .module = createShaderModule(m_device, shader),
+                                          .pName  = "main"};
+    VkComputePipelineCreateInfo pipelineInfo{.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                                             .stage  = stage,
+                                             .layout = m_descriptors.getPipeLayout()};
+    m_pipeline = pipelineCache.createCompute(pipelineInfo, shader.filename);
+    vkDestroyShaderModule(m_device, stage.module, nullptr);
+  }
+
+  void deinit()
+  {
+    if(m_device == VK_NULL_HANDLE)
+      return;
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    destroyResources();
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    m_descriptors.deinit();
+    m_timer.deinit();
+    m_semaphores.destroy(m_device);
+    vkDestroyFence(m_device, m_fence, nullptr);
+    vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+    m_device = VK_NULL_HANDLE;
+  }
+
+  bool isValid() const { return m_device != VK_NULL_HANDLE; }
+
+  // (Re)creates the volume, the maximum of its bricks and the occupancy for `resolution` voxels per side
+  void resize(uint32_t resolution)
+  {
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    destroyResources();
+    m_resolution = resolution;
+    m_nextBrick  = 0;
+    m_filled     = false;
+
+    const uint32_t bricks = bricksPerSide();
+    for(Texture* texture : {&m_density, &m_occupancy})
+    {
+      const uint32_t    size = texture == &m_density ? resolution : bricks;
+      VkImageCreateInfo imageInfo{.sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                                  .imageType   = VK_IMAGE_TYPE_3D,
+                                  .format      = VK_FORMAT_R16_SFLOAT,
+                                  .extent      = {size, size, size},
+                                  .mipLevels   = 1,
+                                  .arrayLayers = 1,
+                                  .samples     = VK_SAMPLE_COUNT_1_BIT,
+                                  .tiling      = VK_IMAGE_TILING_OPTIMAL,
+                                  .usage       = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT};
+      nvvk::Image           image  = m_alloc->createImage(imageInfo);
+      VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageInfo);
+      texture->image.texVk         = m_alloc->createTexture(image, ivInfo);
+      texture->image.imgSize       = imageInfo.extent;
+      // Trilinear density, and the occupancy of a brick is only fetched
+      const GLint filter = texture == &m_density ? GL_LINEAR : GL_NEAREST;
+      createTextureGL(*m_alloc, texture->image, GL_R16F, filter, filter, GL_CLAMP_TO_EDGE);
+      texture->state.init(texture->image.texVk.image, texture->image.oglId, VK_IMAGE_LAYOUT_UNDEFINED, m_queueFamily);
+    }
+
+    VkImageCreateInfo imageInfo{.sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                                .imageType   = VK_IMAGE_TYPE_3D,
+                                .format      = VK_FORMAT_R16_SFLOAT,
+                                .extent      = {bricks, bricks, bricks},
+                                .mipLevels   = 1,
+                                .arrayLayers = 1,
+                                .samples     = VK_SAMPLE_COUNT_1_BIT,
+                                .tiling      = VK_IMAGE_TILING_OPTIMAL,
+                                .usage       = VK_IMAGE_USAGE_STORAGE_BIT};
+    nvvk::Image           image  = m_alloc->createImage(imageInfo);
+    VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageInfo);
+    m_brickMax                   = m_alloc->createTexture(image, ivInfo);
+
+    const VkDescriptorImageInfo density{.imageView = m_density.image.texVk.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkDescriptorImageInfo brickMax{.imageView = m_brickMax.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkDescriptorImageInfo occupancy{.imageView = m_occupancy.image.texVk.descriptor.imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    const VkWriteDescriptorSet  writes[3] = {m_descriptors.makeWrite(0, 0, &density), m_descriptors.makeWrite(0, 1, &brickMax),
+                                             m_descriptors.makeWrite(0, 2, &occupancy)};
+    vkUpdateDescriptorSets(m_device, 3, writes, 0, nullptr);
+  }
+
+  uint32_t resolution() const { return m_resolution; }
+  uint32_t bricksPerSide() const { return m_resolution / kBrickSize; }
+  uint32_t brickCount() const { return bricksPerSide() * bricksPerSide() * bricksPerSide(); }
+
+  // OpenGL objects: R16F densities, and R16F occupancy of the bricks
+  GLuint densityTexture() const { return m_density.image.oglId; }
+  GLuint occupancyTexture() const { return m_occupancy.image.oglId; }
+
+  // Bricks computed by the last command buffer
+  uint32_t lastBrickCount() const { return m_lastBrickCount; }
+
+  // GPU time of the last update, negative if there is none
+  double lastGpuMs() const { return m_timer.lastMs(); }
+
+  // Adds the interop resources of the next submission to the frame's registry
+  void registerInterop(nvvk::InteropRegistry& registry)
+  {
+    nvvk::InteropBatch& batch = registry.batch(m_semaphores.glReady, m_semaphores.glComplete);
+    batch.addTexture(m_density.state, VK_IMAGE_LAYOUT_GENERAL);
+    batch.addTexture(m_occupancy.state, VK_IMAGE_LAYOUT_GENERAL);
+  }
+
+  // `time` is the animation time in seconds
+  void buildCommandBuffer(float time, const VolumeSettings& settings)
+  {
+    NVVK_CHECK(vkWaitForFences(m_device, 1, &m_fence, true, UINT64_MAX));
+    NVVK_CHECK(vkResetFences(m_device, 1, &m_fence));
+
+    VkCommandBufferBeginInfo beginInfo{.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                                       .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+    NVVK_CHECK(vkBeginCommandBuffer(m_commandBuffer, &beginInfo));
+    // The bricks not updated keep their content: GENERAL to GENERAL after the first frame
+    m_density.state.acquireVk(m_commandBuffer, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_SHADER_WRITE_BIT);
+    m_occupancy.state.acquireVk(m_commandBuffer, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                VK_ACCESS_SHADER_WRITE_BIT);
+    if(!m_filled)
+    {
+      VkImageMemoryBarrier initLayout{.sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                                      .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                                      .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
+                                      .newLayout        = VK_IMAGE_LAYOUT_GENERAL,
+                                      .image            = m_brickMax.image,
+                                      .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+      vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                           0, nullptr, 0, nullptr, 1, &initLayout);
+    }
+
+    // The whole volume the first time, it has no content yet
+    const uint32_t total  = brickCount();
+    const uint32_t bricks = m_filled ? std::clamp(uint32_t(std::ceil(float(total) * settings.updateFraction)), 1u, total) : total;
+
+    m_timer.begin(m_commandBuffer);
+    const VkDescriptorSet set = m_descriptors.getSet(0);
+    vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(m_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_descriptors.getPipeLayout(), 0, 1, &set, 0, nullptr);
+    VolumePushConstants pushc{.pass = 0, .firstBrick = m_nextBrick, .brickCount = bricks, .time = time};
+    vkCmdPushConstants(m_commandBuffer, m_descriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+    // One workgroup per brick, in rows of kDispatchWidth to stay within maxComputeWorkGroupCount
+    vkCmdDispatch(m_commandBuffer, std::min(bricks, kDispatchWidth), (bricks + kDispatchWidth - 1) / kDispatchWidth, 1);
+
+    // The occupancy reads the maxima of the neighbor bricks
+    VkMemoryBarrier barrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
+    vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+    pushc.pass = 1;
+    vkCmdPushConstants(m_commandBuffer, m_descriptors.getPipeLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushc), &pushc);
+    const uint32_t side = bricksPerSide();
+    vkCmdDispatch(m_commandBuffer, (side + 7) / 8, (side + 7) / 8, (side + 3) / 4);
+    m_timer.end(m_commandBuffer);
+
+    m_density.state.releaseVk(m_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    m_occupancy.state.releaseVk(m_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    NVVK_CHECK(vkEndCommandBuffer(m_commandBuffer));
+
+    m_nextBrick      = (m_nextBrick + bricks) % total;
+    m_lastBrickCount = bricks;
+    m_filled         = true;
+  }
+
+  // Waits for OpenGL to hand the resources over, and signals when they are written
+  void submit()
+  {
+    const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkSubmitInfo               submitInfo{.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                                          .waitSemaphoreCount   = 1,
+                                          .pWaitSemaphores      = &m_semaphores.vkReady,
+                                          .pWaitDstStageMask    = &waitStage,
+                                          .commandBufferCount   = 1,
+                                          .pCommandBuffers      = &m_commandBuffer,
+                                          .signalSemaphoreCount = 1,
+                                          .pSignalSemaphores    = &m_semaphores.vkComplete};
+    NVVK_CHECK(vkQueueSubmit(m_queue, 1, &submitInfo, m_fence));
+  }
+
+private:
+  static constexpr uint32_t kDispatchWidth = 4096;  // Workgroups per row of the brick dispatch
+
+  struct Texture
+  {
+    nvvk::Texture3DVkGL     image;
+    nvvk::InteropImageState state;
+  };
+
+  void destroyResources()
+  {
+    if(m_resolution == 0)
+      return;
+    m_density.image.destroy(*m_alloc);
+    m_occupancy.image.destroy(*m_alloc);
+    m_alloc->destroy(m_brickMax);
+    m_density    = {};
+    m_occupancy  = {};
+    m_brickMax   = {};
+    m_resolution = 0;
+  }
+
+  VkDevice                     m_device{};
+  nvvk::ResourceAllocator*     m_alloc{nullptr};
+  uint32_t                     m_queueFamily{0};
+  VkQueue                      m_queue{};
+  VkCommandPool                m_commandPool{};
+  VkCommandBuffer              m_commandBuffer{};
+  VkFence                      m_fence{};
+  nvvk::InteropSemaphores      m_semaphores;
+  nvvk::DescriptorSetContainer m_descriptors;
+  VkPipeline                   m_pipeline{};
+  nvvk::GpuTimer               m_timer;
+  uint32_t                     m_resolution{0};
+  Texture                      m_density;        // R16F, in [0, 1]
+  Texture                      m_occupancy;      // R16F, per brick, dilated maximum density
+  nvvk::Texture                m_brickMax;       // R16F, per brick, Vulkan only
+  uint32_t                     m_nextBrick{0};   // First brick of the next update
+  uint32_t                     m_lastBrickCount{0};
+  bool                         m_filled{false};  // All bricks were computed once, m_brickMax is in GENERAL
+};